@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+constexpr std::size_t AGED_KEYS    = 1 << 20;
+constexpr std::size_t CHURN_ROUNDS = 4 * AGED_KEYS;
+
+struct aged_tree {
+    tlib::bst<std::uint64_t> tree_;
+    std::vector<std::uint64_t> keys_;
+};
+
+// Random inserts followed by rounds of erasing a random key and inserting a new one, so the
+// live nodes end up scattered over the heap
+std::unique_ptr<aged_tree> make_aged_tree() {
+    std::unique_ptr<aged_tree> aged( new aged_tree );
+    std::mt19937_64 gen( 2018 );
+    while ( aged->keys_.size() < AGED_KEYS ) {
+        std::uint64_t key = gen();
+        if ( aged->tree_.insert( key ).second ) aged->keys_.push_back( key );
+    }
+    for ( std::size_t round = 0; round < CHURN_ROUNDS; ++round ) {
+        std::uint64_t& victim = aged->keys_[gen() % aged->keys_.size()];
+        aged->tree_.erase( victim );
+        do {
+            victim = gen();
+        } while ( !aged->tree_.insert( victim ).second );
+    }
+    return aged;
+}
+
+void find_random_keys( benchmark::State& state, const aged_tree& aged ) {
+    std::mt19937_64 gen( 7 );
+    for ( auto _ : state ) {
+        std::uint64_t key = aged.keys_[gen() % aged.keys_.size()];
+        benchmark::DoNotOptimize( aged.tree_.find( key ) );
+    }
+    state.SetItemsProcessed( state.iterations() );
+}
+} // namespace
+
+static void BM_FindAged( benchmark::State& state ) {
+    static const std::unique_ptr<aged_tree> aged = make_aged_tree();
+    find_random_keys( state, *aged );
+}
+BENCHMARK( BM_FindAged );
+
+static void BM_FindCompacted( benchmark::State& state ) {
+    static const std::unique_ptr<aged_tree> aged = [] {
+        auto result = make_aged_tree();
+        result->tree_.compact();
+        return result;
+    }();
+    find_random_keys( state, *aged );
+}
+BENCHMARK( BM_FindCompacted );
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+constexpr std::size_t TREE_KEYS  = 1 << 20;
+constexpr std::size_t PROBE_KEYS = 1 << 18;
+
+struct join_input {
+    tlib::bst<std::uint64_t> tree_;
+    std::vector<std::uint64_t> probes_;
+};
+
+// A tree of random keys and a sorted probe list drawn from the same range, about one probe
+// every four tree keys, so consecutive probes are close in key order
+const join_input& make_join_input() {
+    static const join_input* input = [] {
+        join_input* result = new join_input;
+        std::mt19937_64 gen( 2018 );
+        std::uniform_int_distribution<std::uint64_t> keys( 0, 1ull << 40 );
+        while ( result->tree_.size() < TREE_KEYS )
+            result->tree_.insert( keys( gen ) );
+        for ( std::size_t i = 0; i < PROBE_KEYS; ++i )
+            result->probes_.push_back( keys( gen ) );
+        std::sort( result->probes_.begin(), result->probes_.end() );
+        return result;
+    }();
+    return *input;
+}
+} // namespace
+
+// Sorted probe join, every lookup from the root
+static void BM_SortedJoinFind( benchmark::State& state ) {
+    const join_input& input = make_join_input();
+    for ( auto _ : state ) {
+        std::size_t matches = 0;
+        for ( auto key : input.probes_ ) {
+            auto it = input.tree_.lower_bound( key );
+            if ( it != input.tree_.end() ) matches += *it - key < 1024;
+        }
+        benchmark::DoNotOptimize( matches );
+    }
+    state.SetItemsProcessed( state.iterations() * input.probes_.size() );
+}
+BENCHMARK( BM_SortedJoinFind )->Unit( benchmark::kMillisecond );
+
+// Same join, every lookup starting from the previous result
+static void BM_SortedJoinFinger( benchmark::State& state ) {
+    const join_input& input = make_join_input();
+    for ( auto _ : state ) {
+        std::size_t matches = 0;
+        auto finger         = input.tree_.cbegin();
+        for ( auto key : input.probes_ ) {
+            auto it = input.tree_.lower_bound_from( finger, key );
+            if ( it != input.tree_.end() ) matches += *it - key < 1024;
+            finger = it;
+        }
+        benchmark::DoNotOptimize( matches );
+    }
+    state.SetItemsProcessed( state.iterations() * input.probes_.size() );
+}
+BENCHMARK( BM_SortedJoinFinger )->Unit( benchmark::kMillisecond );
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+constexpr int INGEST_KEYS = 1 << 18;
+
+const std::vector<std::uint64_t>& ingest_keys() {
+    static const std::vector<std::uint64_t> keys = [] {
+        std::mt19937_64 gen( 2018 );
+        std::vector<std::uint64_t> result( INGEST_KEYS );
+        for ( auto& key : result )
+            key = gen();
+        return result;
+    }();
+    return keys;
+}
+} // namespace
+
+// Baseline: one full descent per key
+static void BM_DirectInsert( benchmark::State& state ) {
+    const auto& keys = ingest_keys();
+    for ( auto _ : state ) {
+        tlib::bst<std::uint64_t> tree;
+        for ( auto key : keys )
+            tree.insert( key );
+        benchmark::DoNotOptimize( tree.size() );
+    }
+    state.SetItemsProcessed( state.iterations() * keys.size() );
+}
+BENCHMARK( BM_DirectInsert )->Unit( benchmark::kMillisecond );
+
+// Staged inserts, merged every state.range(0) keys and once more by the final flush()
+static void BM_BufferedInsert( benchmark::State& state ) {
+    const auto& keys = ingest_keys();
+    for ( auto _ : state ) {
+        tlib::bst<std::uint64_t> tree;
+        tree.set_insert_buffer( state.range( 0 ) );
+        for ( auto key : keys )
+            tree.insert_buffered( key );
+        tree.flush();
+        benchmark::DoNotOptimize( tree.size() );
+    }
+    state.SetItemsProcessed( state.iterations() * keys.size() );
+}
+BENCHMARK( BM_BufferedInsert )
+    ->Arg( 64 )
+    ->Arg( 1024 )
+    ->Arg( 16384 )
+    ->Arg( 1 << 18 )
+    ->Unit( benchmark::kMillisecond );
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+constexpr std::size_t STRING_KEYS = 1 << 18;
+
+// Same order as std::less<std::string>, but a different type, so nodes cache no prefix
+struct plain_less {
+    bool operator()( const std::string& a, const std::string& b ) const {
+        return a < b;
+    }
+};
+
+// Random 24 byte keys, too long for the small string buffer, so the characters live on the
+// heap away from the node
+const std::vector<std::string>& string_keys() {
+    static const std::vector<std::string> keys = [] {
+        std::mt19937 gen( 2018 );
+        std::uniform_int_distribution<int> letter( 'a', 'z' );
+        std::vector<std::string> result( STRING_KEYS );
+        for ( auto& key : result )
+            for ( int i = 0; i < 24; ++i )
+                key.push_back( static_cast<char>( letter( gen ) ) );
+        return result;
+    }();
+    return keys;
+}
+
+template<class Tree_> void find_strings( benchmark::State& state ) {
+    const auto& keys = string_keys();
+    Tree_ tree;
+    for ( const auto& key : keys )
+        tree.insert( key );
+    std::mt19937 gen( 7 );
+    for ( auto _ : state )
+        benchmark::DoNotOptimize( tree.find( keys[gen() % keys.size()] ) );
+    state.SetItemsProcessed( state.iterations() );
+}
+} // namespace
+
+static void BM_StringFindPrefixCached( benchmark::State& state ) {
+    find_strings<tlib::bst<std::string>>( state );
+}
+BENCHMARK( BM_StringFindPrefixCached );
+
+static void BM_StringFindFullCompare( benchmark::State& state ) {
+    find_strings<tlib::bst<std::string, plain_less>>( state );
+}
+BENCHMARK( BM_StringFindFullCompare );
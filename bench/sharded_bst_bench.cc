@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include "lib/bst.h"
+#include "lib/sharded_bst.h"
+
+namespace {
+constexpr std::uint32_t KEY_RANGE = 1 << 20;
+constexpr std::uint32_t PREFILL   = 1 << 16;
+
+// The bst every thread writes to, behind a single lock
+struct locked_bst {
+    std::mutex lock_;
+    tlib::bst<std::uint32_t> tree_;
+};
+
+using sharded_set =
+    tlib::sharded_bst<std::uint32_t, std::less<std::uint32_t>, std::allocator<std::uint32_t>, 64>;
+
+locked_bst* locked_   = nullptr;
+sharded_set* sharded_ = nullptr;
+
+template<class Set_, class Insert_> void prefill( Set_& set, Insert_ insert ) {
+    std::mt19937 gen( 1 );
+    std::uniform_int_distribution<std::uint32_t> keys( 0, KEY_RANGE );
+    for ( std::uint32_t i = 0; i < PREFILL; ++i )
+        insert( set, keys( gen ) );
+}
+} // namespace
+
+// Every thread alternates inserting and erasing uniformly random keys
+static void BM_LockedBstWrites( benchmark::State& state ) {
+    if ( state.thread_index() == 0 ) {
+        locked_ = new locked_bst;
+        prefill( *locked_, []( locked_bst& set, std::uint32_t key ) { set.tree_.insert( key ); } );
+    }
+    std::mt19937 gen( state.thread_index() + 2 );
+    std::uniform_int_distribution<std::uint32_t> keys( 0, KEY_RANGE );
+    bool insert = true;
+    for ( auto _ : state ) {
+        std::uint32_t key = keys( gen );
+        std::lock_guard<std::mutex> guard( locked_->lock_ );
+        if ( insert )
+            locked_->tree_.insert( key );
+        else
+            locked_->tree_.erase( key );
+        insert = !insert;
+    }
+    state.SetItemsProcessed( state.iterations() );
+    if ( state.thread_index() == 0 ) {
+        delete locked_;
+        locked_ = nullptr;
+    }
+}
+BENCHMARK( BM_LockedBstWrites )->ThreadRange( 1, 64 )->UseRealTime();
+
+static void BM_ShardedBstWrites( benchmark::State& state ) {
+    if ( state.thread_index() == 0 ) {
+        sharded_ = new sharded_set;
+        prefill( *sharded_, []( sharded_set& set, std::uint32_t key ) { set.insert( key ); } );
+    }
+    std::mt19937 gen( state.thread_index() + 2 );
+    std::uniform_int_distribution<std::uint32_t> keys( 0, KEY_RANGE );
+    bool insert = true;
+    for ( auto _ : state ) {
+        std::uint32_t key = keys( gen );
+        if ( insert )
+            sharded_->insert( key );
+        else
+            sharded_->erase( key );
+        insert = !insert;
+    }
+    state.SetItemsProcessed( state.iterations() );
+    if ( state.thread_index() == 0 ) {
+        delete sharded_;
+        sharded_ = nullptr;
+    }
+}
+BENCHMARK( BM_ShardedBstWrites )->ThreadRange( 1, 64 )->UseRealTime();
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <exception>
+#include <vector>
+
 #include "config.h"
 
 #include "bst_node.h"
@@ -39,31 +43,41 @@ public:
     using const_pointer   = typename alloc_traits_::const_pointer;
 
 private:
-    using node_               = bst_node<Key_, typename alloc_traits_::void_pointer>;
-    using const_node_         = const bst_node<Key_, typename alloc_traits_::void_pointer>;
+    using node_ = bst_node<Key_, typename alloc_traits_::void_pointer,
+                           bst_cache_prefix<Key_, Compare_>::value>;
+    using const_node_         = const node_;
     using node_allocator_     = typename alloc_traits_::template rebind_alloc<node_>;
     using node_traits_        = std::allocator_traits<node_allocator_>;
     using node_pointer_       = typename node_traits_::pointer;
     using const_node_pointer_ = typename node_traits_::const_pointer;
+    using prefix_type_        = typename node_::prefix_type;
 
 public:
     using iterator         = tlib::bst_iterator<node_>;
     using const_iterator   = tlib::bst_iterator<const_node_>;
     using node_destructor_ = bst_node_destructor<node_allocator_>;
     using node_holder_     = std::unique_ptr<node_, node_destructor_>;
+    using detached_nodes   = bst_detached_nodes<node_allocator_>;
+
+    // height of the subtrees laid out next to each other by compact
+    static constexpr size_t COMPACT_BLOCK_DEPTH = 4;
 
     // Iterators
     /**
-     * @brief Returns an iterator to the first element(smallest value)
+     * @brief Returns an iterator to the first element(smallest value), merging the staged
+     * values first
      *
      * @return iterator iterator to the first element
      */
-    iterator begin() noexcept {
+    iterator begin() {
+        flush();
         return make_iterator( header_->left_ );
     }
 
     /**
-     * @brief Returns an constant iterator to the first element(smallest value)
+     * @brief Returns an constant iterator to the first element(smallest value). Like every
+     * const read apart from contains, it does not see values staged by insert_buffered;
+     * call flush() first
      *
      * @return const_iterator constant iterator to the first element
      */
@@ -114,7 +128,8 @@ public:
     }
 
     /**
-     * @brief returns the number of elements
+     * @brief returns the number of elements. Values still staged by insert_buffered are not
+     * counted until a flush() or a read through a non-const tree merges them
      *
      * @return size_t number of elements
      */
@@ -131,6 +146,7 @@ public:
      * @return std::pair<iterator, bool> iterator to the inserted element, true if unique element
      */
     std::pair<iterator, bool> insert( const value_type& value ) {
+        flush();
         return insert_unique( value );
     }
 
@@ -152,14 +168,89 @@ public:
      */
     std::pair<iterator, bool> insert( value_type&& value ) {
         // std::cout << "rvalue insert " << std::endl;
+        flush();
         return insert_unique( std::move( value ) );
     }
 
+    /**
+     * @brief Insert elements without looking for their position yet
+     * The value is appended to the staging buffer, which is sorted and merged into the tree
+     * once it holds insert_buffer() values, on flush(), before the next modification and
+     * before any read through a non-const tree. Const reads never modify the tree, so apart
+     * from contains they only see the staged values after a flush(). With a zero sized
+     * buffer this is a plain insert
+     *
+     * @param value value to be inserted
+     */
+    void insert_buffered( const value_type& value ) {
+        if ( buffer_threshold_ == 0 ) {
+            insert( value );
+            return;
+        }
+        staged_.push_back( value );
+        if ( staged_.size() >= buffer_threshold_ ) merge_staged();
+    }
+
+    void insert_buffered( value_type&& value ) {
+        if ( buffer_threshold_ == 0 ) {
+            insert( std::move( value ) );
+            return;
+        }
+        staged_.push_back( std::move( value ) );
+        if ( staged_.size() >= buffer_threshold_ ) merge_staged();
+    }
+
+    /**
+     * @brief sets how many values insert_buffered stages before merging them
+     *
+     * @param threshold size of the staging buffer, 0 disables buffering
+     */
+    void set_insert_buffer( size_type threshold ) {
+        buffer_threshold_ = threshold;
+        if ( staged_.size() >= buffer_threshold_ ) merge_staged();
+        staged_.reserve( threshold );
+    }
+
+    /**
+     * @brief returns the size of the staging buffer
+     *
+     * @return size_type number of values staged before a merge, 0 if buffering is off
+     */
+    size_type insert_buffer() const noexcept {
+        return buffer_threshold_;
+    }
+
+    /**
+     * @brief merges the staged values into the tree. Iterators stay valid, existing nodes are
+     * relinked but never moved
+     *
+     */
+    void flush() {
+        if ( !staged_.empty() ) merge_staged();
+    }
+
+    /**
+     * @brief returns the number of values waiting in the staging buffer, duplicates included
+     *
+     * @return size_type number of staged values
+     */
+    size_type staged() const noexcept {
+        return staged_.size();
+    }
+
     /**
      * @brief clears the contents
      *
      */
-    void clear() noexcept;
+    void clear() noexcept {
+        staged_.clear();
+        detached_nodes released_( nat_, root(), size_, slabs_ );
+        reset_header();
+        slab_.reset();
+        slabs_.clear();
+        compaction_ = compaction_state_();
+        ++version_;
+    }
 
     // erase elements
     /**
@@ -168,7 +259,45 @@ public:
      * @param pos iterator to the given position
      * @return iterator
      */
-    iterator erase( const_iterator pos );
+    iterator erase( const_iterator pos ) {
+        flush();
+        node_pointer_ z = pos.pointee_;
+        iterator next( z );
+        ++next;
+        ++version_;
+        if ( size_ == ONE_NODE ) {
+            reset_header();
+            delete_node( z );
+            return end();
+        }
+        if ( z == leftmost() ) leftmost() = next.pointee_;
+        if ( z == rightmost() )
+            rightmost() = z->left_ != nullptr ? tree_max( z->left_ ) : z->parent_;
+        // the node leaving its place is z, or its successor when z has two children
+        shrink_counts( z->left_ != nullptr && z->right_ != nullptr ? tree_min( z->right_ )->parent_
+                                                                  : z->parent_ );
+
+        if ( z->left_ == nullptr )
+            transplant( z, z->right_ );
+        else if ( z->right_ == nullptr )
+            transplant( z, z->left_ );
+        else {
+            // replace z with its successor, the minimum of the right subtree
+            node_pointer_ y = tree_min( z->right_ );
+            if ( y->parent_ != z ) {
+                transplant( y, y->right_ );
+                y->right_          = z->right_;
+                y->right_->parent_ = y;
+            }
+            transplant( z, y );
+            y->left_          = z->left_;
+            y->left_->parent_ = y;
+            y->count_         = z->count_;
+        }
+        delete_node( z );
+        size_--;
+        return next;
+    }
 
     /**
      * @brief erarses element in the range of positions
@@ -177,18 +306,317 @@ public:
      * @param last iterator to the last element
      * @return iterator iterator to the replaced element for the first
      */
-    iterator erase( const_iterator first, const_iterator last );
+    iterator erase( const_iterator first, const_iterator last ) {
+        flush();
+        if ( first != last ) {
+            if ( last == cend() )
+                detach_range( first, nullptr );
+            else
+                detach_range( first, std::addressof( *last ) );
+        }
+        return iterator( last.pointee_ );
+    }
+
+    /**
+     * @brief erases all the elements in the range [lo, hi)
+     * The range is cut out of the tree with two splits and a join and counted from the
+     * subtree sizes kept in the nodes, which is O(height); destroying the k erased elements
+     * then makes the call O(height + k) overall
+     *
+     * @param lo first key to erase
+     * @param hi first key after lo to keep
+     * @return size_type number of elements erased
+     */
+    size_type erase_range( const key_type& lo, const key_type& hi ) {
+        return extract_range( lo, hi ).size();
+    }
+
+    /**
+     * @brief unlinks all the elements in the range [lo, hi) without releasing them, in
+     * O(height). The returned holder only keeps the root of the detached subtree and walks
+     * the nodes when it releases them, on destruction, so callers guarding the tree with a
+     * lock can move all the O(k) work past the point where the lock is dropped
+     *
+     * @param lo first key to extract
+     * @param hi first key after lo to keep
+     * @return detached_nodes holder owning the extracted nodes
+     */
+    detached_nodes extract_range( const key_type& lo, const key_type& hi ) {
+        flush();
+        if ( !compare_( lo, hi ) ) return detached_nodes( nat_ );
+        return detach_range( const_iterator( lower_bound_node( lo ) ), std::addressof( hi ) );
+    }
+
+    /**
+     * @brief unlinks the elements in the range of positions [first, last) without releasing
+     * them, see extract_range
+     *
+     * @param first iterator to the first element to extract
+     * @param last iterator to the first element to keep
+     * @return detached_nodes holder owning the extracted nodes
+     */
+    detached_nodes extract( const_iterator first, const_iterator last ) {
+        flush();
+        if ( first == last ) return detached_nodes( nat_ );
+        if ( last == cend() ) return detach_range( first, nullptr );
+        return detach_range( first, std::addressof( *last ) );
+    }
+
+    /**
+     * @brief links the nodes of a detached subtree in after the largest element, in
+     * O(height) and without copying or allocating any node. Every key in nodes must be
+     * greater than every key of the tree, and nodes must come from a tree whose allocator
+     * compares equal to this one
+     *
+     * @param nodes holder of the subtree, left empty
+     */
+    void adopt( detached_nodes&& nodes ) {
+        flush();
+        if ( nodes.root_ == nullptr ) return;
+        // the adopted nodes may live in slabs of their old tree, keep those alive here
+        for ( const auto& slab : nodes.slabs_ )
+            if ( std::find( slabs_.begin(), slabs_.end(), slab ) == slabs_.end() )
+                slabs_.push_back( slab );
+        ++version_;
+        node_pointer_ upper   = nodes.root_;
+        size_type count       = nodes.size_;
+        upper->parent_        = nullptr;
+        nodes.root_           = nullptr;
+        nodes.size_           = 0;
+        nodes.slabs_.clear();
+        node_pointer_ tree = root();
+        if ( tree != nullptr ) tree->parent_ = nullptr;
+        set_root( join( tree, upper ), size_ + count );
+    }
 
-    size_type erase( const key_type& key );
+    /**
+     * @brief erases the element with the given key
+     *
+     * @param key key of the element to erase
+     * @return size_type number of elements erased (0 or 1)
+     */
+    size_type erase( const key_type& key ) {
+        flush();
+        node_pointer_ y = lower_bound_node( key );
+        if ( y == header_ || compare_( key, y->key_ ) ) return 0;
+        erase( const_iterator( y ) );
+        return 1;
+    }
 
     // Lookup
     /**
-     * @brief Find the given key
+     * @brief Find the given key, merging the staged values first
      *
      * @param x key to be find
      * @return iterator itertor to the found key
      */
-    iterator find( key_type const& x ) const;
+    iterator find( key_type const& x ) {
+        flush();
+        return static_cast<const bst&>( *this ).find( x );
+    }
+
+    /**
+     * @brief Find the given key. Does not see staged values
+     *
+     * @param x key to be find
+     * @return iterator itertor to the found key
+     */
+    iterator find( key_type const& x ) const {
+        node_pointer_ y = lower_bound_node( x );
+        if ( y == header_ || compare_( x, y->key_ ) ) return iterator( header_ );
+        return iterator( y );
+    }
+
+    /**
+     * @brief checks whether the key is present, merging the staged values first
+     *
+     * @param x key to look for
+     * @return true if the key is present
+     */
+    bool contains( key_type const& x ) {
+        flush();
+        return static_cast<const bst&>( *this ).find( x ) != end();
+    }
+
+    /**
+     * @brief checks whether the key is present in the tree or among the staged values,
+     * without merging them
+     *
+     * @param x key to look for
+     * @return true if the key is present
+     */
+    bool contains( key_type const& x ) const {
+        if ( find( x ) != iterator( header_ ) ) return true;
+        for ( const value_type& value : staged_ )
+            if ( !compare_( x, value ) && !compare_( value, x ) ) return true;
+        return false;
+    }
+
+    /**
+     * @brief Returns an iterator to the first element not less than the given key, merging
+     * the staged values first
+     *
+     * @param x key to compare the elements to
+     * @return iterator iterator to the element, end() if there is none
+     */
+    iterator lower_bound( key_type const& x ) {
+        flush();
+        return static_cast<const bst&>( *this ).lower_bound( x );
+    }
+
+    /**
+     * @brief Returns an iterator to the first element not less than the given key. Does not
+     * see staged values
+     *
+     * @param x key to compare the elements to
+     * @return iterator iterator to the element, end() if there is none
+     */
+    iterator lower_bound( key_type const& x ) const {
+        return iterator( lower_bound_node( x ) );
+    }
+
+    /**
+     * @brief Returns an iterator to the element at the given position in key order, merging
+     * the staged values first
+     *
+     * @param n position of the element, counting from 0
+     * @return iterator iterator to the element, end() if n is not less than size()
+     */
+    iterator nth( size_type n ) {
+        flush();
+        return static_cast<const bst&>( *this ).nth( n );
+    }
+
+    /**
+     * @brief Returns an iterator to the element at the given position in key order, in
+     * O(height) thanks to the subtree sizes kept in the nodes. Does not see staged values
+     *
+     * @param n position of the element, counting from 0
+     * @return iterator iterator to the element, end() if n is not less than size()
+     */
+    iterator nth( size_type n ) const {
+        node_pointer_ x = header_->parent_;
+        while ( x != nullptr ) {
+            size_type left = count_of( x->left_ );
+            if ( n == left ) return iterator( x );
+            if ( n < left ) {
+                x = x->left_;
+            } else {
+                n -= left + 1;
+                x = x->right_;
+            }
+        }
+        return iterator( header_ );
+    }
+
+    // Finger search
+    /**
+     * @brief lower_bound starting from a known position instead of the root. The search climbs
+     * from the finger until it has passed the result and descends back towards the finger,
+     * so its cost follows the tree path between the two. On a balanced tree that averages
+     * O(log d) over the fingers, d being the number of elements between the finger and the
+     * result, but a finger high up in the tree can still need O(height) steps even for a
+     * neighbour: without level links only sorted runs of nearby lookups gain on average
+     *
+     * @param finger any valid iterator of this tree, end() included
+     * @param x key to compare the elements to
+     * @return iterator iterator to the first element not less than x, end() if there is none
+     */
+    iterator lower_bound_from( const_iterator finger, key_type const& x ) const {
+        return iterator( lower_bound_node_from( finger.pointee_, x ) );
+    }
+
+    /**
+     * @brief find starting from a known position, see lower_bound_from
+     *
+     * @param finger any valid iterator of this tree, end() included
+     * @param x key to be find
+     * @return iterator iterator to the found key, end() if not present
+     */
+    iterator find_from( const_iterator finger, key_type const& x ) const {
+        node_pointer_ y = lower_bound_node_from( finger.pointee_, x );
+        if ( y == header_ || compare_( x, y->key_ ) ) return iterator( header_ );
+        return iterator( y );
+    }
+
+    /**
+     * @brief Insert elements, looking for their position from a known one, see
+     * lower_bound_from. The new node is linked directly before the lower bound
+     *
+     * @param finger any valid iterator of this tree, end() included
+     * @param value value to be inserted
+     * @return std::pair<iterator, bool> iterator to the inserted element, true if unique element
+     */
+    std::pair<iterator, bool> insert_from( const_iterator finger, const value_type& value ) {
+        flush();
+        node_pointer_ y = lower_bound_node_from( finger.pointee_, value );
+        if ( y != header_ && !compare_( value, y->key_ ) )
+            return std::make_pair( make_iterator( y ), false );
+        node_pointer_ z = make_node_holder( value ).release();
+        link_before( y, z );
+        return std::make_pair( make_iterator( z ), true );
+    }
+
+    // Compaction
+    /**
+     * @brief relocates all the nodes into one contiguous slab, laid out so that the top
+     * levels of every subtree of COMPACT_BLOCK_DEPTH levels sit next to each other, and
+     * recursively below them. Lookups then touch far fewer cache lines and pages than on a
+     * tree whose nodes were allocated one at a time over a long run of churn.
+     * Invalidates all iterators
+     *
+     */
+    void compact() {
+        while ( !compact_step( static_cast<size_type>( -1 ) ) ) {
+        }
+    }
+
+    /**
+     * @brief relocates at most max_nodes nodes of an ongoing compaction, starting one if
+     * needed. Meant to be called repeatedly during idle periods; the tree can be used
+     * between the steps, but modifying it restarts the compaction. A restarted pass walks
+     * over the nodes already in the slab being filled without moving them and keeps filling
+     * that slab while it has room, and slabs are freed as soon as their last node is gone,
+     * so steps interleaved with writes do not pile up memory. Invalidates all iterators
+     *
+     * @param max_nodes most nodes to relocate in this step
+     * @return true if the tree is fully compacted
+     */
+    bool compact_step( size_type max_nodes ) {
+        flush();
+        if ( compacted_version_ == version_ + 1 ) return true;
+        if ( !compaction_.active_ || compaction_.version_ != version_ ) {
+            if ( size_ == 0 ) {
+                slab_.reset();
+                slabs_.clear();
+                compaction_        = compaction_state_();
+                compacted_version_ = version_ + 1;
+                return true;
+            }
+            start_compaction();
+        }
+
+        while ( max_nodes > 0 ) {
+            if ( compaction_.next_in_block_ == compaction_.block_.size() ) {
+                if ( compaction_.roots_.empty() ) break;
+                collect_block();
+                continue;
+            }
+            node_pointer_ p = compaction_.block_[compaction_.next_in_block_++];
+            if ( slab_->owns( p ) ) continue;
+            if ( slab_->room() == 0 ) add_slab();
+            relocate( p, slab_->take() );
+            --max_nodes;
+        }
+
+        if ( compaction_.next_in_block_ < compaction_.block_.size() ||
+             !compaction_.roots_.empty() )
+            return false;
+        compaction_        = compaction_state_();
+        compacted_version_ = version_ + 1;
+        release_empty_slabs();
+        return true;
+    }
 
     // Observers
     /**
@@ -225,21 +653,56 @@ public:
      */
     explicit bst( const Compare_& comp = Compare_(), const Allocator_& alloc = Allocator_() )
         : compare_( comp ), nat_( node_allocator_( alloc ) ), size_( 0 ),
-          header_( make_node_holder( value_type{} ).release() ) {
+          header_( make_node_holder( value_type{} ).release() ), staged_( alloc ) {
         this->header_->left_  = this->header_;
         this->header_->right_ = this->header_;
     };
 
+    bst( const bst& ) = delete;
+    bst& operator=( const bst& ) = delete;
+
     // Destructors
-    ~bst() = default;
+    ~bst() {
+        clear();
+        delete_node( header_ );
+    }
 
 private:
     const key_compare compare_;
     node_allocator_ nat_;
     size_t size_;
     node_pointer_ header_;
+    std::vector<value_type, Allocator_> staged_;
+    size_type buffer_threshold_ = 0;
+
+    using node_slab_ = bst_node_slab<node_allocator_>;
+
+    /**
+     * @brief progress of an incremental compaction
+     */
+    struct compaction_state_ {
+        bool active_       = false;
+        size_type version_ = 0;
+        // roots of the blocks still to lay out, the next one on top
+        std::vector<node_pointer_> roots_;
+        // nodes of the current block in breadth first order
+        std::vector<node_pointer_> block_;
+        size_type next_in_block_ = 0;
+    };
+
+    // every slab still holding live nodes, and the one being filled
+    typename detached_nodes::slabs slabs_;
+    std::shared_ptr<node_slab_> slab_;
+    compaction_state_ compaction_;
+    // bumped by every change to the shape of the tree
+    size_type version_ = 0;
+    // version_ + 1 of the last fully compacted shape, 0 if there is none
+    size_type compacted_version_ = 0;
 
     static constexpr size_t ONE_NODE = 1;
+    // a new slab has room for size_ / COMPACT_SLACK more nodes than the tree holds, so that
+    // passes restarted after small changes can keep filling it
+    static constexpr size_t COMPACT_SLACK = 4;
 
     iterator make_iterator( node_pointer_& node ) noexcept {
         return iterator( node );
@@ -250,7 +713,103 @@ private:
     }
 
     void delete_node( node_pointer_ node ) {
-        // node_allocator_.deallocate( node, ONE_NODE );
+        node_traits_::destroy( nat_, std::addressof( *node ) );
+        for ( auto slab = slabs_.begin(); slab != slabs_.end(); ++slab )
+            if ( ( *slab )->owns( node ) ) {
+                if ( ( *slab )->drop() && *slab != slab_ ) slabs_.erase( slab );
+                return;
+            }
+        node_traits_::deallocate( nat_, node, ONE_NODE );
+    }
+
+    /**
+     * @brief starts a compaction pass over the current shape. The slab being filled is kept
+     * if its unused slots look enough for the nodes outside of it, otherwise a new one is
+     * allocated
+     *
+     */
+    void start_compaction() {
+        size_type placed = slab_ == nullptr ? 0 : std::min( size_, slab_->live() );
+        if ( slab_ == nullptr || slab_->room() < size_ - placed ) add_slab();
+        release_empty_slabs();
+        compaction_          = compaction_state_();
+        compaction_.active_  = true;
+        compaction_.version_ = version_;
+        compaction_.roots_.push_back( root() );
+    }
+
+    /**
+     * @brief allocates a new slab sized after the tree and makes it the one being filled
+     *
+     */
+    void add_slab() {
+        slab_ = std::make_shared<node_slab_>( nat_, size_ + size_ / COMPACT_SLACK );
+        slabs_.push_back( slab_ );
+    }
+
+    /**
+     * @brief lets go of the slabs whose nodes have all been destroyed, apart from the one
+     * being filled. Detached nodes keep their own reference to the slabs they live in
+     *
+     */
+    void release_empty_slabs() {
+        slabs_.erase( std::remove_if( slabs_.begin(), slabs_.end(),
+                                      [this]( const std::shared_ptr<node_slab_>& slab ) {
+                                          return slab != slab_ && slab->live() == 0;
+                                      } ),
+                      slabs_.end() );
+    }
+
+    /**
+     * @brief takes the next block root and gathers the nodes of its top COMPACT_BLOCK_DEPTH
+     * levels. The subtrees hanging below the block are pushed so that the leftmost one is
+     * laid out next
+     *
+     */
+    void collect_block() {
+        node_pointer_ block_root = compaction_.roots_.back();
+        compaction_.roots_.pop_back();
+        compaction_.block_.clear();
+        compaction_.next_in_block_ = 0;
+        compaction_.block_.push_back( block_root );
+        size_type level_begin = 0;
+        for ( size_t depth = 1; depth < COMPACT_BLOCK_DEPTH; ++depth ) {
+            size_type level_end = compaction_.block_.size();
+            for ( size_type i = level_begin; i < level_end; ++i ) {
+                node_pointer_ x = compaction_.block_[i];
+                if ( x->left_ != nullptr ) compaction_.block_.push_back( x->left_ );
+                if ( x->right_ != nullptr ) compaction_.block_.push_back( x->right_ );
+            }
+            level_begin = level_end;
+        }
+        for ( size_type i = compaction_.block_.size(); i > level_begin; --i ) {
+            node_pointer_ x = compaction_.block_[i - 1];
+            if ( x->right_ != nullptr ) compaction_.roots_.push_back( x->right_ );
+            if ( x->left_ != nullptr ) compaction_.roots_.push_back( x->left_ );
+        }
+    }
+
+    /**
+     * @brief moves the node p into the unconstructed slot q and relinks its neighbours
+     *
+     */
+    void relocate( node_pointer_ p, node_pointer_ q ) {
+        node_traits_::construct( nat_, std::addressof( *q ), std::move( p->key_ ) );
+        q->left_   = p->left_;
+        q->right_  = p->right_;
+        q->parent_ = p->parent_;
+        q->count_  = p->count_;
+        if ( q->left_ != nullptr ) q->left_->parent_ = q;
+        if ( q->right_ != nullptr ) q->right_->parent_ = q;
+        if ( p->parent_ == header_ )
+            header_->parent_ = q;
+        else if ( p == p->parent_->left_ )
+            p->parent_->left_ = q;
+        else
+            p->parent_->right_ = q;
+        if ( leftmost() == p ) leftmost() = q;
+        if ( rightmost() == p ) rightmost() = q;
+        delete_node( p );
     }
 
     node_holder_ make_node_holder( const value_type& value ) {
@@ -273,11 +832,26 @@ private:
     // Modifiers
     // Insert elements. Make this as const iterator??
     std::pair<iterator, bool> insert_unique( const value_type& value ) {
-        node_holder_ h_             = make_node_holder( std::move( value ) );
+        return insert_node_holder( make_node_holder( value ) );
+    }
+
+    template<typename Vp_> std::pair<iterator, bool> insert_unique( Vp_&& value ) {
+        return insert_node_holder( make_node_holder( std::move( value ) ) );
+    }
+
+    /**
+     * @brief links the held node in its place, or drops it if its key is already present
+     *
+     * @param h_ holder of the new node
+     * @return std::pair<iterator, bool> iterator to the element with the key, true if linked
+     */
+    std::pair<iterator, bool> insert_node_holder( node_holder_ h_ ) {
         node_pointer_ root_         = ( *header_ ).parent_;
-        node_pointer_ inserted_node = h_.release();
+        node_pointer_ inserted_node = h_.get();
 
         if ( root_ == nullptr ) {
+            h_.release();
+            ++version_;
             ( *header_ ).parent_   = inserted_node;
             ( *header_ ).left_     = inserted_node;
             ( *header_ ).right_    = inserted_node;
@@ -286,83 +860,451 @@ private:
             return std::make_pair( make_iterator( inserted_node ), true );
         }
 
+        const key_type& key  = inserted_node->key_;
+        prefix_type_ prefix  = node_::make_prefix( key );
         node_pointer_ parent = root_;
         node_pointer_ x      = root_;
+        int order            = 0;
 
         while ( x != nullptr ) {
             parent = x;
-            if ( compare_( inserted_node->key_, x->key_ ) )
+            order  = compare_to_node( key, prefix, x );
+            if ( order < 0 )
                 x = x->left_;
-            else if ( compare_( x->key_, inserted_node->key_ ) )
+            else if ( order > 0 )
                 x = x->right_;
             else
                 return std::make_pair( make_iterator( x ), false );
         }
 
-        if ( compare_( inserted_node->key_, parent->key_ ) ) {
+        if ( order < 0 )
             parent->left_ = inserted_node;
-        } else
+        else
             parent->right_ = inserted_node;
+        h_.release();
+        ++version_;
         inserted_node->parent_ = parent;
+        grow_counts( parent );
         // Update leftmost and right most
-        if ( compare_( inserted_node->key_, leftmost()->key_ ) ) ( *header_ ).left_ = inserted_node;
-        if ( !( compare_( inserted_node->key_, rightmost()->key_ ) ) &&
-             !( compare_( rightmost()->key_, inserted_node->key_ ) ) ) {
-            ( *header_ ).right_   = inserted_node;
-            inserted_node->right_ = header_;
-        }
+        if ( key_less( key, prefix, leftmost() ) ) ( *header_ ).left_ = inserted_node;
+        if ( node_less( rightmost(), key, prefix ) ) ( *header_ ).right_ = inserted_node;
 
         size_++;
         return std::make_pair( make_iterator( inserted_node ), true );
     }
 
-    template<typename Vp_> std::pair<iterator, bool> insert_unique( Vp_&& value ) {
-        node_holder_ h_             = make_node_holder( std::move( value ) );
-        node_pointer_ root_         = ( *header_ ).parent_;
-        node_pointer_ inserted_node = h_.release();
+    /**
+     * @brief orders a key against the key of a node, looking at the cached prefixes first
+     * when the node has them
+     *
+     * @param key key to order
+     * @param prefix node_::make_prefix( key )
+     * @param x node to compare with
+     * @return int negative if key is before x, positive if after, 0 if equivalent
+     */
+    int compare_to_node( const key_type& key, prefix_type_ prefix, node_pointer_ x ) const {
+        int by_prefix = x->compare_prefix( prefix );
+        if ( by_prefix != 0 ) return -by_prefix;
+        if ( compare_( key, x->key_ ) ) return -1;
+        if ( compare_( x->key_, key ) ) return 1;
+        return 0;
+    }
 
-        if ( root_ == nullptr ) {
-            ( *header_ ).parent_   = inserted_node;
-            ( *header_ ).left_     = inserted_node;
-            ( *header_ ).right_    = inserted_node;
-            inserted_node->parent_ = header_;
-            size_++;
-            return std::make_pair( make_iterator( inserted_node ), true );
+    /**
+     * @brief whether the key of the node x is less than key, with a single comparison
+     *
+     * @param prefix node_::make_prefix( key )
+     */
+    bool node_less( node_pointer_ x, const key_type& key, prefix_type_ prefix ) const {
+        int by_prefix = x->compare_prefix( prefix );
+        return by_prefix != 0 ? by_prefix < 0 : compare_( x->key_, key );
+    }
+
+    /**
+     * @brief whether key is less than the key of the node x, with a single comparison
+     *
+     * @param prefix node_::make_prefix( key )
+     */
+    bool key_less( const key_type& key, prefix_type_ prefix, node_pointer_ x ) const {
+        int by_prefix = x->compare_prefix( prefix );
+        return by_prefix != 0 ? by_prefix > 0 : compare_( key, x->key_ );
+    }
+
+    node_pointer_& root() {
+        return this->header_->parent_;
+    }
+
+    /**
+     * @brief sorts and deduplicates the staging buffer and merges it into the tree
+     * A batch which is large next to the tree is merged in one linear pass: the tree nodes
+     * are collected in order, merged with the batch and relinked as a perfectly balanced
+     * tree. A small batch is cheaper to insert one by one, in key order.
+     * If making a node throws, the values merged so far stay in the tree and the rest stay
+     * staged, so no value is lost
+     */
+    void merge_staged() {
+        if ( staged_.empty() ) return;
+        std::sort( staged_.begin(), staged_.end(), compare_ );
+        auto equal_ = [this]( const value_type& a, const value_type& b ) {
+            return !compare_( a, b ) && !compare_( b, a );
+        };
+        staged_.erase( std::unique( staged_.begin(), staged_.end(), equal_ ), staged_.end() );
+
+        size_type batch = staged_.size();
+        size_type depth = 1;
+        for ( size_type n = size_; n > 1; n >>= 1 )
+            ++depth;
+        size_type done = 0;
+        if ( batch * depth < size_ ) {
+            try {
+                for ( ; done < batch; ++done )
+                    insert_unique( std::move_if_noexcept( staged_[done] ) );
+            } catch ( ... ) {
+                staged_.erase( staged_.begin(), staged_.begin() + done );
+                throw;
+            }
+            staged_.clear();
+            return;
         }
 
-        node_pointer_ parent = root_;
-        node_pointer_ x      = root_;
+        std::vector<node_pointer_> nodes;
+        nodes.reserve( size_ );
+        for ( iterator it = make_iterator( header_->left_ ); it.pointee_ != header_; ++it )
+            nodes.push_back( it.pointee_ );
+
+        std::vector<node_pointer_> merged;
+        merged.reserve( size_ + batch );
+        std::exception_ptr error;
+        auto x = nodes.begin();
+        try {
+            for ( ; done < batch; ++done ) {
+                const value_type& value = staged_[done];
+                while ( x != nodes.end() && compare_( ( *x )->key_, value ) )
+                    merged.push_back( *x++ );
+                if ( x != nodes.end() && !compare_( value, ( *x )->key_ ) ) continue;
+                merged.push_back(
+                    make_node_holder( std::move_if_noexcept( staged_[done] ) ).release() );
+            }
+        } catch ( ... ) {
+            // link what has been merged so far, the remaining values stay staged
+            error = std::current_exception();
+        }
+        merged.insert( merged.end(), x, nodes.end() );
+        staged_.erase( staged_.begin(), staged_.begin() + done );
+
+        if ( !merged.empty() ) {
+            ++version_;
+            node_pointer_ tree = build_balanced( merged.data(), merged.size(), header_ );
+            header_->parent_   = tree;
+            header_->left_     = merged.front();
+            header_->right_    = merged.back();
+            size_              = merged.size();
+        }
+        if ( error ) std::rethrow_exception( error );
+    }
+
+    /**
+     * @brief links the sorted nodes into a perfectly balanced tree
+     *
+     * @param first first of the nodes in key order
+     * @param count number of nodes
+     * @param parent parent of the subtree
+     * @return node_pointer_ root of the subtree
+     */
+    static node_pointer_ build_balanced( node_pointer_* first, size_type count,
+                                         node_pointer_ parent ) noexcept {
+        if ( count == 0 ) return nullptr;
+        size_type mid   = count / 2;
+        node_pointer_ x = first[mid];
+        x->parent_      = parent;
+        x->count_       = count;
+        x->left_        = build_balanced( first, mid, x );
+        x->right_       = build_balanced( first + mid + 1, count - mid - 1, x );
+        return x;
+    }
+
+    /**
+     * @brief puts the subtree v in the place of the subtree u
+     *
+     */
+    void transplant( node_pointer_ u, node_pointer_ v ) noexcept {
+        if ( u->parent_ == header_ )
+            header_->parent_ = v;
+        else if ( u == u->parent_->left_ )
+            u->parent_->left_ = v;
+        else
+            u->parent_->right_ = v;
+        if ( v != nullptr ) v->parent_ = u->parent_;
+    }
+
+    /**
+     * @brief points the header back at itself, as in an empty tree
+     *
+     */
+    void reset_header() noexcept {
+        header_->parent_ = nullptr;
+        header_->left_   = header_;
+        header_->right_  = header_;
+        size_            = 0;
+    }
+
+    static size_type count_of( node_pointer_ x ) noexcept {
+        return x == nullptr ? 0 : x->count_;
+    }
+
+    /**
+     * @brief counts one more node in the subtrees of x and of all its ancestors
+     *
+     */
+    void grow_counts( node_pointer_ x ) noexcept {
+        for ( ; x != header_; x = x->parent_ )
+            ++x->count_;
+    }
+
+    /**
+     * @brief counts one node less in the subtrees of x and of all its ancestors
+     *
+     */
+    void shrink_counts( node_pointer_ x ) noexcept {
+        for ( ; x != header_; x = x->parent_ )
+            --x->count_;
+    }
+
+    static node_pointer_ tree_min( node_pointer_ x ) noexcept {
+        while ( x->left_ != nullptr )
+            x = x->left_;
+        return x;
+    }
+
+    static node_pointer_ tree_max( node_pointer_ x ) noexcept {
+        while ( x->right_ != nullptr )
+            x = x->right_;
+        return x;
+    }
 
+    /**
+     * @brief first node whose key is not less than the given key
+     *
+     * @param key key to search for
+     * @return node_pointer_ the node, or header_ if there is none
+     */
+    node_pointer_ lower_bound_node( const key_type& key ) const {
+        prefix_type_ prefix  = node_::make_prefix( key );
+        node_pointer_ result = header_;
+        node_pointer_ x      = header_->parent_;
         while ( x != nullptr ) {
-            parent = x;
-            if ( compare_( inserted_node->key_, x->key_ ) )
-                x = x->left_;
-            else if ( compare_( x->key_, inserted_node->key_ ) )
+            if ( node_less( x, key, prefix ) )
                 x = x->right_;
-            else
-                return std::make_pair( make_iterator( x ), false );
+            else {
+                result = x;
+                x      = x->left_;
+            }
         }
+        return result;
+    }
 
-        if ( compare_( inserted_node->key_, parent->key_ ) )
-            parent->left_ = inserted_node;
+    /**
+     * @brief first node whose key is not less than the given key, searched from the node x
+     * If key is after x, the nodes between them are x's right subtree and, for every
+     * ancestor reached from its left child, that ancestor and its right subtree. The climb
+     * stops at the first such ancestor not less than key and the descent starts from the
+     * right subtree of the last one passed, which is less than key. If key is not after x
+     * the mirror image holds with the ancestors reached from their right child. Only those
+     * ancestors and the nodes of the final descent are compared, which keeps the search on
+     * the tree path between x and the result, plus the climb to the ancestor that bounds it
+     *
+     * @param x node to start from, header_ for end()
+     * @param key key to search for
+     * @return node_pointer_ the node, or header_ if there is none
+     */
+    node_pointer_ lower_bound_node_from( node_pointer_ x, const key_type& key ) const {
+        if ( header_->parent_ == nullptr ) return header_;
+        if ( x == header_ ) x = header_->right_;
 
-        else
-            parent->right_ = inserted_node;
-        inserted_node->parent_ = parent;
-        // Update leftmost and right most
-        if ( compare_( inserted_node->key_, leftmost()->key_ ) ) ( *header_ ).left_ = inserted_node;
-        if ( !( compare_( inserted_node->key_, rightmost()->key_ ) ) &&
-             !( compare_( rightmost()->key_, inserted_node->key_ ) ) ) {
-            ( *header_ ).right_   = inserted_node;
-            inserted_node->right_ = header_;
+        prefix_type_ prefix  = node_::make_prefix( key );
+        node_pointer_ result = header_;
+        node_pointer_ last   = x;
+        if ( node_less( x, key, prefix ) ) {
+            while ( x->parent_ != header_ ) {
+                node_pointer_ p = x->parent_;
+                if ( x == p->left_ ) {
+                    if ( !node_less( p, key, prefix ) ) {
+                        result = p;
+                        break;
+                    }
+                    last = p;
+                }
+                x = p;
+            }
+            x = last->right_;
+        } else {
+            while ( x->parent_ != header_ ) {
+                node_pointer_ p = x->parent_;
+                if ( x == p->right_ ) {
+                    if ( node_less( p, key, prefix ) ) break;
+                    last = p;
+                }
+                x = p;
+            }
+            result = last;
+            x      = last->left_;
+        }
+        while ( x != nullptr ) {
+            if ( node_less( x, key, prefix ) )
+                x = x->right_;
+            else {
+                result = x;
+                x      = x->left_;
+            }
         }
+        return result;
+    }
 
+    /**
+     * @brief links the new node z as the in order predecessor of y
+     *
+     * @param y node to insert before, header_ to insert at the end
+     * @param z node to link
+     */
+    void link_before( node_pointer_ y, node_pointer_ z ) noexcept {
+        ++version_;
         size_++;
-        return std::make_pair( make_iterator( inserted_node ), true );
+        if ( header_->parent_ == nullptr ) {
+            header_->parent_ = z;
+            header_->left_   = z;
+            header_->right_  = z;
+            z->parent_       = header_;
+            return;
+        }
+        if ( y == header_ ) {
+            z->parent_         = header_->right_;
+            z->parent_->right_ = z;
+            header_->right_    = z;
+        } else if ( y->left_ == nullptr ) {
+            z->parent_ = y;
+            y->left_   = z;
+            if ( y == header_->left_ ) header_->left_ = z;
+        } else {
+            z->parent_         = tree_max( y->left_ );
+            z->parent_->right_ = z;
+        }
+        grow_counts( z->parent_ );
     }
 
-    node_pointer_& root() {
-        return this->header_->parent_;
+    /**
+     * @brief splits the subtree x into the nodes less than key and the rest
+     * Walks a single root to leaf path, handing each node (with one of its subtrees) to the
+     * side it belongs to.
+     *
+     * @param x root of the subtree to split
+     * @param key splitting key
+     * @return std::pair<node_pointer_, node_pointer_> roots of the lower and upper trees
+     */
+    std::pair<node_pointer_, node_pointer_> split( node_pointer_ x, const key_type& key ) {
+        prefix_type_ prefix  = node_::make_prefix( key );
+        node_pointer_ lower  = nullptr;
+        node_pointer_ upper  = nullptr;
+        node_pointer_ l_tail = nullptr;
+        node_pointer_ u_tail = nullptr;
+        while ( x != nullptr ) {
+            node_pointer_ next;
+            if ( node_less( x, key, prefix ) ) {
+                next       = x->right_;
+                x->parent_ = l_tail;
+                if ( l_tail == nullptr )
+                    lower = x;
+                else
+                    l_tail->right_ = x;
+                l_tail = x;
+            } else {
+                next       = x->left_;
+                x->parent_ = u_tail;
+                if ( u_tail == nullptr )
+                    upper = x;
+                else
+                    u_tail->left_ = x;
+                u_tail = x;
+            }
+            x = next;
+        }
+        if ( l_tail != nullptr ) l_tail->right_ = nullptr;
+        if ( u_tail != nullptr ) u_tail->left_ = nullptr;
+        // only the nodes on the two spines changed subtrees, recount them bottom up
+        for ( node_pointer_ y = l_tail; y != nullptr; y = y->parent_ )
+            y->count_ = 1 + count_of( y->left_ ) + count_of( y->right_ );
+        for ( node_pointer_ y = u_tail; y != nullptr; y = y->parent_ )
+            y->count_ = 1 + count_of( y->left_ ) + count_of( y->right_ );
+        return std::make_pair( lower, upper );
+    }
+
+    /**
+     * @brief joins two subtrees where every key of lower is less than every key of upper
+     * The maximum of lower becomes the new root, so the height grows by at most one. Both
+     * roots must have a null parent, the subtree counts are fixed up along the moved path
+     *
+     * @param lower root of the lower tree
+     * @param upper root of the upper tree
+     * @return node_pointer_ root of the joined tree
+     */
+    static node_pointer_ join( node_pointer_ lower, node_pointer_ upper ) noexcept {
+        if ( lower == nullptr ) return upper;
+        if ( upper == nullptr ) return lower;
+        node_pointer_ m = tree_max( lower );
+        if ( m != lower ) {
+            for ( node_pointer_ y = m->parent_; y != nullptr; y = y->parent_ )
+                --y->count_;
+            m->parent_->right_ = m->left_;
+            if ( m->left_ != nullptr ) m->left_->parent_ = m->parent_;
+            m->left_       = lower;
+            lower->parent_ = m;
+        }
+        m->right_      = upper;
+        upper->parent_ = m;
+        m->count_      = 1 + count_of( m->left_ ) + upper->count_;
+        return m;
+    }
+
+    /**
+     * @brief unlinks the nodes from first up to (not including) the key hi
+     *
+     * @param first first node to unlink
+     * @param hi key bounding the range, nullptr to unlink up to the end
+     * @return detached_nodes holder owning the unlinked nodes
+     */
+    detached_nodes detach_range( const_iterator first, const key_type* hi ) {
+        if ( first == cend() ) return detached_nodes( nat_ );
+        ++version_;
+        node_pointer_ tree   = root();
+        tree->parent_        = nullptr;
+        auto lower_rest      = split( tree, *first );
+        node_pointer_ doomed = lower_rest.second;
+        node_pointer_ rest   = nullptr;
+        if ( hi != nullptr ) {
+            auto doomed_rest = split( lower_rest.second, *hi );
+            doomed           = doomed_rest.first;
+            rest             = doomed_rest.second;
+        }
+        detached_nodes released_( nat_, doomed, count_of( doomed ), slabs_ );
+        set_root( join( lower_rest.first, rest ), size_ - released_.size() );
+        return released_;
+    }
+
+    /**
+     * @brief hangs a subtree with a null parent below the header as the whole tree
+     *
+     * @param tree root of the subtree, nullptr for an empty tree
+     * @param size number of nodes in the subtree
+     */
+    void set_root( node_pointer_ tree, size_type size ) noexcept {
+        if ( tree == nullptr ) {
+            reset_header();
+            return;
+        }
+        tree->parent_    = header_;
+        header_->parent_ = tree;
+        header_->left_   = tree_min( tree );
+        header_->right_  = tree_max( tree );
+        size_            = size;
     }
 
     const_node_pointer_& root() const {
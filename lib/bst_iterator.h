@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iterator>
+#include <type_traits>
 
 namespace tlib {
 /**
@@ -16,6 +17,8 @@ class bst_iterator
     using node_pointer_ = typename bst_node_t_::pointer;
 
     template<class, class, class> friend class bst;
+    template<class, class, class> friend class interval_set;
+    template<class> friend class bst_iterator;
 
 public:
     using iterator_category = const std::bidirectional_iterator_tag;
@@ -71,10 +74,17 @@ private:
         // then the successor is the left most element of the right subtree
         if ( x_->right_ != nullptr ) return tree_min( x_->right_ );
         // Case 2: if there is no element in the right  and this node is parent's right child
-        while ( !is_left_child( x_ ) )
-            x_ = x_->parent_;
+        // climb until we come up from a left child. The root's parent is the header, whose
+        // right_ is the rightmost node, so the climb from the last node ends at the header
+        node_pointer_ y_ = x_->parent_;
+        while ( x_ == static_cast<node_pointer_>( y_->right_ ) ) {
+            x_ = y_;
+            y_ = y_->parent_;
+        }
         // Case 3: if there is no element in the right  and this node is parent's left child
-        return x_->parent_;
+        // (a single node tree climbs past the header and has to step back onto it)
+        if ( x_->right_ != y_ ) x_ = y_;
+        return x_;
     }
 
 public:
@@ -142,6 +152,16 @@ public:
      */
     bst_iterator();
 
+    /**
+     * @brief Construct a constant iterator from a mutable one
+     *
+     * @param other iterator to the same node
+     */
+    template<class other_node_t_, class = typename std::enable_if<
+                                      std::is_same<const other_node_t_, bst_node_t_>::value &&
+                                      !std::is_same<other_node_t_, bst_node_t_>::value>::type>
+    bst_iterator( const bst_iterator<other_node_t_>& other ) : pointee_( other.pointee_ ) {}
+
     /**
      * @brief Destroy the bst iterator object
      * Destructor
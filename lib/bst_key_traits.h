@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "config.h"
+
+namespace tlib {
+
+/**
+ * @brief Describes how to build an order preserving prefix of a key. The primary template
+ * has none; specializations set has_prefix and provide make(), which must satisfy
+ * make(a) < make(b) implies a < b, so that only equal prefixes need the full comparison
+ *
+ * @tparam Key_ the key type
+ */
+template<class Key_> struct bst_key_prefix {
+    static constexpr bool has_prefix = false;
+    using prefix_type                = std::uint64_t;
+};
+
+/**
+ * @brief First 8 bytes of a character string packed big-endian, zero padded. Comparing two
+ * of these as integers orders them like a bytewise (unsigned char) comparison of the strings
+ *
+ */
+struct bst_bytes_prefix {
+    static constexpr bool has_prefix = true;
+    using prefix_type                = std::uint64_t;
+
+    LIBCPP_INLINE_VISIBILITY_
+    static prefix_type make( const char* data, std::size_t size ) noexcept {
+        prefix_type prefix = 0;
+        std::size_t n      = size < sizeof( prefix_type ) ? size : sizeof( prefix_type );
+        for ( std::size_t i = 0; i < n; ++i )
+            prefix |= static_cast<prefix_type>( static_cast<unsigned char>( data[i] ) )
+                      << ( 8 * ( sizeof( prefix_type ) - 1 - i ) );
+        return prefix;
+    }
+};
+
+template<> struct bst_key_prefix<std::string> : bst_bytes_prefix {
+    static prefix_type make( const std::string& key ) noexcept {
+        return bst_bytes_prefix::make( key.data(), key.size() );
+    }
+};
+
+#if __cplusplus >= 201703L
+template<> struct bst_key_prefix<std::string_view> : bst_bytes_prefix {
+    static prefix_type make( std::string_view key ) noexcept {
+        return bst_bytes_prefix::make( key.data(), key.size() );
+    }
+};
+#endif
+
+/**
+ * @brief Whether a bst with this key and comparator caches key prefixes in its nodes. Only
+ * the natural order agrees with the prefix order, so any other comparator turns it off
+ *
+ * @tparam Key_ the key type
+ * @tparam Compare_ the comparator of the bst
+ */
+template<class Key_, class Compare_>
+struct bst_cache_prefix
+    : std::integral_constant<bool, bst_key_prefix<Key_>::has_prefix &&
+                                       ( std::is_same<Compare_, std::less<Key_>>::value ||
+                                         std::is_same<Compare_, std::less<void>>::value )> {};
+
+/**
+ * @brief Storage for the cached prefix, laid out at the front of bst_node. Empty, and free
+ * thanks to the empty base optimization, when prefixes are not cached
+ *
+ * @tparam Key_ the key type
+ * @tparam CachePrefix_ whether the prefix is stored
+ */
+template<class Key_, bool CachePrefix_> class bst_node_prefix {
+public:
+    using prefix_type = typename bst_key_prefix<Key_>::prefix_type;
+
+    LIBCPP_INLINE_VISIBILITY_
+    static prefix_type make_prefix( const Key_& ) noexcept {
+        return 0;
+    }
+
+    LIBCPP_INLINE_VISIBILITY_
+    explicit bst_node_prefix( const Key_& ) noexcept {}
+
+    /**
+     * @brief orders this node's key against a key with the given prefix using the prefixes
+     * alone
+     *
+     * @return int negative if the node is smaller, positive if it is larger, 0 if undecided
+     */
+    LIBCPP_INLINE_VISIBILITY_
+    constexpr int compare_prefix( prefix_type ) const noexcept {
+        return 0;
+    }
+};
+
+template<class Key_> class bst_node_prefix<Key_, true> {
+public:
+    using prefix_type = typename bst_key_prefix<Key_>::prefix_type;
+
+    LIBCPP_INLINE_VISIBILITY_
+    static prefix_type make_prefix( const Key_& key ) noexcept {
+        return bst_key_prefix<Key_>::make( key );
+    }
+
+    LIBCPP_INLINE_VISIBILITY_
+    explicit bst_node_prefix( const Key_& key ) noexcept : prefix_( make_prefix( key ) ) {}
+
+    LIBCPP_INLINE_VISIBILITY_
+    int compare_prefix( prefix_type prefix ) const noexcept {
+        return prefix_ < prefix ? -1 : ( prefix < prefix_ ? 1 : 0 );
+    }
+
+    prefix_type prefix_;
+};
+} // namespace tlib
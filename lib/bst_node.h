@@ -1,10 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
+
+#include "bst_key_traits.h"
 
 namespace tlib {
 
+// forward declare bst class, which takes detached nodes back in
+template<class Key_, class Compare_, class Allocator_> class bst;
+
 template<class Allocator_> class bst_node_destructor {
     using allocator_type    = Allocator_;
     using allocator_traits_ = std::allocator_traits<allocator_type>;
@@ -38,11 +47,231 @@ public:
     LIBCPP_INLINE_VISIBILITY_
     void operator()( pointer p_ ) noexcept {
         if ( value_constructed_ )
-            allocator_traits_::destroy( node_allocator_, std::addressof( p_->key_ ) );
-        if ( p_ ) {
-            allocator_traits_::deallocate( node_allocator_, p_, 1 );
-            std::cout << "deallocating node pointer" << std::endl;
+            allocator_traits_::destroy( node_allocator_, std::addressof( *p_ ) );
+        if ( p_ ) allocator_traits_::deallocate( node_allocator_, p_, 1 );
+    }
+};
+
+/**
+ * @brief One contiguous allocation holding many nodes, filled by bst::compact.
+ * Slots are handed out in order and never reused. Nodes living in a slab are destroyed one
+ * by one but never deallocated on their own; the slab counts its live nodes so that its
+ * owners can let go of it once the last one is gone, and the memory goes back to the
+ * allocator when the last owner does.
+ *
+ * @tparam Allocator_ node allocator rebinded from type Key
+ */
+template<class Allocator_> class bst_node_slab {
+    using allocator_type    = Allocator_;
+    using allocator_traits_ = std::allocator_traits<allocator_type>;
+
+public:
+    using pointer   = typename allocator_traits_::pointer;
+    using size_type = typename allocator_traits_::size_type;
+
+    /**
+     * @brief allocates room for capacity nodes, none of them constructed
+     *
+     * @param node_allocator allocator to take the memory from
+     * @param capacity number of nodes
+     */
+    bst_node_slab( const allocator_type& node_allocator, size_type capacity )
+        : node_allocator_( node_allocator ), capacity_( capacity ), used_( 0 ), live_( 0 ),
+          base_( allocator_traits_::allocate( node_allocator_, capacity ) ) {}
+
+    bst_node_slab( const bst_node_slab& ) = delete;
+    bst_node_slab& operator=( const bst_node_slab& ) = delete;
+
+    ~bst_node_slab() {
+        allocator_traits_::deallocate( node_allocator_, base_, capacity_ );
+    }
+
+    /**
+     * @brief hands out the next unused slot, counting the node about to be built in it
+     *
+     * @return pointer address of the slot
+     */
+    pointer take() noexcept {
+        live_.fetch_add( 1, std::memory_order_relaxed );
+        return base_ + used_++;
+    }
+
+    /**
+     * @brief counts one node of the slab as destroyed. Safe to call from several threads
+     *
+     * @return true if it was the last live node
+     */
+    bool drop() noexcept {
+        return live_.fetch_sub( 1, std::memory_order_acq_rel ) == 1;
+    }
+
+    size_type capacity() const noexcept {
+        return capacity_;
+    }
+
+    /**
+     * @brief returns the number of slots never handed out
+     *
+     */
+    size_type room() const noexcept {
+        return capacity_ - used_;
+    }
+
+    /**
+     * @brief returns the number of nodes alive in the slab
+     *
+     */
+    size_type live() const noexcept {
+        return live_.load( std::memory_order_acquire );
+    }
+
+    /**
+     * @brief checks whether the node lives in this slab
+     *
+     * @param p pointer to a node
+     * @return true if p is one of the slots
+     */
+    bool owns( pointer p ) const noexcept {
+        std::less<const void*> less_;
+        const void* x = std::addressof( *p );
+        return !less_( x, std::addressof( *base_ ) ) &&
+               less_( x, std::addressof( *base_ ) + capacity_ );
+    }
+
+private:
+    allocator_type node_allocator_;
+    size_type capacity_;
+    size_type used_;
+    std::atomic<size_type> live_;
+    pointer base_;
+};
+
+/**
+ * @brief Owns nodes which have been unlinked from a bst but not yet released.
+ * Only the root of the detached subtree is kept, along with a size the tree already knows,
+ * so taking ownership does not walk the nodes. Destroying the holder walks the subtree,
+ * destroying the keys and deallocating the nodes, which lets callers move that cost out of a
+ * critical section.
+ *
+ * @tparam Allocator_ node allocator rebinded from type Key
+ */
+template<class Allocator_> class bst_detached_nodes {
+    using allocator_type    = Allocator_;
+    using allocator_traits_ = std::allocator_traits<allocator_type>;
+
+public:
+    using pointer   = typename allocator_traits_::pointer;
+    using size_type = typename allocator_traits_::size_type;
+    using slabs     = std::vector<std::shared_ptr<bst_node_slab<Allocator_>>>;
+
+    /**
+     * @brief Construct an empty holder
+     *
+     * @param node_allocator allocator used to release the nodes
+     */
+    explicit bst_detached_nodes( const allocator_type& node_allocator = allocator_type() )
+        : node_allocator_( node_allocator ), root_( nullptr ), size_( 0 ) {}
+
+    /**
+     * @brief Take ownership of a detached subtree
+     *
+     * @param node_allocator allocator used to release the nodes
+     * @param root root of the detached subtree, may be nullptr
+     * @param size number of nodes in the subtree
+     * @param node_slabs slabs some of the nodes may live in, kept alive until the release
+     */
+    bst_detached_nodes( const allocator_type& node_allocator, pointer root, size_type size,
+                        const slabs& node_slabs = slabs() )
+        : node_allocator_( node_allocator ), root_( root ), size_( size ) {
+        if ( root != nullptr ) slabs_ = node_slabs;
+    }
+
+    bst_detached_nodes( const bst_detached_nodes& ) = delete;
+    bst_detached_nodes& operator=( const bst_detached_nodes& ) = delete;
+
+    bst_detached_nodes( bst_detached_nodes&& other ) noexcept
+        : node_allocator_( std::move( other.node_allocator_ ) ), root_( other.root_ ),
+          size_( other.size_ ), slabs_( std::move( other.slabs_ ) ) {
+        other.root_ = nullptr;
+        other.size_ = 0;
+    }
+
+    bst_detached_nodes& operator=( bst_detached_nodes&& other ) noexcept {
+        if ( this != &other ) {
+            release();
+            node_allocator_ = std::move( other.node_allocator_ );
+            root_           = other.root_;
+            size_           = other.size_;
+            slabs_          = std::move( other.slabs_ );
+            other.root_     = nullptr;
+            other.size_     = 0;
+        }
+        return *this;
+    }
+
+    ~bst_detached_nodes() {
+        release();
+    }
+
+    /**
+     * @brief returns the number of detached nodes
+     *
+     * @return size_type number of nodes
+     */
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    /**
+     * @brief checks whether the holder owns any node
+     *
+     * @return true if no nodes are held
+     */
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    /**
+     * @brief destroys and deallocates all the held nodes
+     *
+     */
+    void release() noexcept {
+        // Flatten the subtree with right rotations while releasing the nodes which have no
+        // left child. Every node is touched a constant number of times, so this is linear
+        // and needs no stack.
+        while ( root_ != nullptr ) {
+            if ( root_->left_ != nullptr ) {
+                pointer l_    = root_->left_;
+                root_->left_  = l_->right_;
+                l_->right_    = root_;
+                root_         = l_;
+            } else {
+                pointer next_ = root_->right_;
+                allocator_traits_::destroy( node_allocator_, std::addressof( *root_ ) );
+                if ( !drop_from_slab( root_ ) )
+                    allocator_traits_::deallocate( node_allocator_, root_, 1 );
+                root_ = next_;
+            }
         }
+        size_ = 0;
+        slabs_.clear();
+    }
+
+private:
+    template<class Key_, class Compare_, class BstAllocator_> friend class bst;
+
+    allocator_type node_allocator_;
+    pointer root_;
+    size_type size_;
+    slabs slabs_;
+
+    bool drop_from_slab( pointer p ) const noexcept {
+        for ( const auto& slab : slabs_ )
+            if ( slab->owns( p ) ) {
+                slab->drop();
+                return true;
+            }
+        return false;
     }
 };
 
@@ -50,15 +279,20 @@ public:
  * @brief Node for Binary Search Tree
  *
  * @tparam Key_
+ * @tparam CachePrefix_ whether the node keeps an order preserving prefix of its key, see
+ * bst_cache_prefix
  */
-template<class Key_, class VoidPointer_> class bst_node {
+template<class Key_, class VoidPointer_, bool CachePrefix_ = false>
+class bst_node : public bst_node_prefix<Key_, CachePrefix_> {
+    using prefix_base_ = bst_node_prefix<Key_, CachePrefix_>;
+
 public:
     // Define typenames
     using key_type        = Key_;
     using value_type      = Key_;
     using const_reference = const value_type&;
-    using pointer_traits =
-        typename std::pointer_traits<VoidPointer_>::template rebind<bst_node<Key_, VoidPointer_>>;
+    using prefix_type     = typename prefix_base_::prefix_type;
+    using pointer_traits  = typename std::pointer_traits<VoidPointer_>::template rebind<bst_node>;
     using pointer = typename std::pointer_traits<VoidPointer_>::template rebind<bst_node>;
     using const_pointer =
         typename std::pointer_traits<VoidPointer_>::template rebind<const bst_node>;
@@ -74,12 +308,22 @@ public:
     LIBCPP_INLINE_VISIBILITY_
     explicit bst_node( const_reference key, pointer left = nullptr, pointer right = nullptr,
                        pointer parent = nullptr )
-        : key_( key ), left_( left ), right_( right ), parent_( parent ) {}
+        : prefix_base_( key ), key_( key ), left_( left ), right_( right ), parent_( parent ) {}
+
+    /**
+     * @brief Construct a new bst node object by moving the key in
+     *
+     * @param key key of the node
+     */
+    LIBCPP_INLINE_VISIBILITY_
+    explicit bst_node( value_type&& key ) : prefix_base_( key ), key_( std::move( key ) ) {}
 
     // Node defination
-    const_reference key_;
+    value_type key_;
     pointer left_{nullptr};
     pointer right_{nullptr};
     pointer parent_{nullptr};
+    // number of nodes in the subtree rooted here
+    std::size_t count_{1};
 };
 } // namespace tlib
\ No newline at end of file
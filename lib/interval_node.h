@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "config.h"
+
+namespace tlib {
+
+/**
+ * @brief Node for the interval set. Same link layout as bst_node, so bst_iterator walks it,
+ * plus the augmentation needed for overlap queries
+ *
+ * @tparam Key_ endpoint type of the intervals
+ * @tparam VoidPointer_ void pointer type of the allocator
+ */
+template<class Key_, class VoidPointer_> class interval_node {
+public:
+    // Define typenames
+    using endpoint_type   = Key_;
+    using key_type        = std::pair<Key_, Key_>;
+    using value_type      = std::pair<Key_, Key_>;
+    using const_reference = const value_type&;
+    using pointer = typename std::pointer_traits<VoidPointer_>::template rebind<interval_node>;
+    using const_pointer =
+        typename std::pointer_traits<VoidPointer_>::template rebind<const interval_node>;
+
+    /**
+     * @brief Construct a new interval node object
+     *
+     * @param key interval [first, second] stored in the node
+     * @param priority heap priority used to keep the tree balanced
+     */
+    LIBCPP_INLINE_VISIBILITY_
+    explicit interval_node( const_reference key, std::uint32_t priority = 0 )
+        : key_( key ), max_( key.second ), priority_( priority ) {}
+
+    // Node defination
+    value_type key_;
+    pointer left_{nullptr};
+    pointer right_{nullptr};
+    pointer parent_{nullptr};
+    // largest right endpoint in the subtree rooted at this node
+    endpoint_type max_;
+    std::uint32_t priority_;
+};
+} // namespace tlib
@@ -0,0 +1,548 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "config.h"
+
+#include "bst_node.h"
+
+#include "bst_iterator.h"
+
+#include "interval_node.h"
+
+namespace tlib {
+
+/**
+ * @brief Ordered set of closed intervals [lo, hi] answering overlap queries.
+ * Intervals are ordered by (lo, hi). The tree is a treap, so rotations keep it balanced in
+ * expectation, and every node carries the largest right endpoint of its subtree, which lets
+ * overlap searches skip whole subtrees.
+ *
+ * @tparam Key_ endpoint type of the intervals
+ * @tparam Compare_ Comparator associated with the type Key
+ * @tparam Allocator_ Allocator to store the intervals
+ */
+template<class Key_, class Compare_ = std::less<Key_>,
+         class Allocator_ = std::allocator<std::pair<Key_, Key_>>>
+class interval_set {
+private:
+    using alloc_traits_ = typename std::allocator_traits<Allocator_>;
+
+public:
+    using endpoint_type   = Key_;
+    using key_type        = std::pair<Key_, Key_>;
+    using value_type      = std::pair<Key_, Key_>;
+    using size_type       = typename alloc_traits_::size_type;
+    using difference_type = typename alloc_traits_::difference_type;
+    using key_compare     = Compare_;
+    using allocator_type  = Allocator_;
+    using reference       = value_type&;
+    using const_reference = const value_type&;
+
+private:
+    using node_            = interval_node<Key_, typename alloc_traits_::void_pointer>;
+    using const_node_      = const interval_node<Key_, typename alloc_traits_::void_pointer>;
+    using node_allocator_  = typename alloc_traits_::template rebind_alloc<node_>;
+    using node_traits_     = std::allocator_traits<node_allocator_>;
+    using node_pointer_    = typename node_traits_::pointer;
+    using node_destructor_ = bst_node_destructor<node_allocator_>;
+    using node_holder_     = std::unique_ptr<node_, node_destructor_>;
+
+public:
+    using iterator       = tlib::bst_iterator<node_>;
+    using const_iterator = tlib::bst_iterator<const_node_>;
+    using detached_nodes = bst_detached_nodes<node_allocator_>;
+
+    /**
+     * @brief Forward iterator over the intervals overlapping a query interval.
+     * Each increment resumes the pruned search from the current node, so nothing is
+     * collected up front
+     */
+    class overlap_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = typename interval_set::value_type;
+        using difference_type   = typename interval_set::difference_type;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        reference operator*() const {
+            return pointee_->key_;
+        }
+
+        pointer operator->() const {
+            return std::addressof( pointee_->key_ );
+        }
+
+        overlap_iterator& operator++() {
+            pointee_ = set_->next_overlap( pointee_, lo_, hi_ );
+            return *this;
+        }
+
+        overlap_iterator operator++( int ) {
+            auto temp_ = *this;
+            ++( *this );
+            return temp_;
+        }
+
+        friend bool operator==( const overlap_iterator& lhs, const overlap_iterator& rhs ) {
+            return lhs.pointee_ == rhs.pointee_;
+        }
+
+        friend bool operator!=( const overlap_iterator& lhs, const overlap_iterator& rhs ) {
+            return !( lhs == rhs );
+        }
+
+    private:
+        friend class interval_set;
+
+        overlap_iterator( const interval_set* set, node_pointer_ pointee, const Key_& lo,
+                          const Key_& hi )
+            : set_( set ), pointee_( pointee ), lo_( lo ), hi_( hi ) {}
+
+        const interval_set* set_;
+        node_pointer_ pointee_;
+        Key_ lo_;
+        Key_ hi_;
+    };
+
+    /**
+     * @brief Result of an overlap query, usable in a range based for loop
+     */
+    class overlap_range {
+    public:
+        overlap_iterator begin() const {
+            return first_;
+        }
+
+        overlap_iterator end() const {
+            return last_;
+        }
+
+        bool empty() const {
+            return first_ == last_;
+        }
+
+    private:
+        friend class interval_set;
+
+        overlap_range( overlap_iterator first, overlap_iterator last )
+            : first_( first ), last_( last ) {}
+
+        overlap_iterator first_;
+        overlap_iterator last_;
+    };
+
+    // Iterators
+    /**
+     * @brief Returns an iterator to the first interval
+     *
+     * @return iterator iterator to the first interval
+     */
+    iterator begin() noexcept {
+        return iterator( header_->left_ );
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator( header_->left_ );
+    }
+
+    const_iterator cbegin() const noexcept {
+        return const_iterator( header_->left_ );
+    }
+
+    /**
+     * @brief Returns an iterator to the end element. End is after the last interval
+     *
+     * @return iterator iterator to the end element
+     */
+    iterator end() noexcept {
+        return iterator( header_ );
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator( header_ );
+    }
+
+    const_iterator cend() const noexcept {
+        return const_iterator( header_ );
+    }
+
+    // Capacity
+    /**
+     * @brief checks whether the container is empty
+     *
+     * @return true if container is empty
+     */
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    /**
+     * @brief returns the number of intervals
+     *
+     * @return size_type number of intervals
+     */
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    // Modifiers
+    /**
+     * @brief Insert the interval [lo, hi]
+     *
+     * @param lo left endpoint
+     * @param hi right endpoint, must not be less than lo
+     * @return std::pair<iterator, bool> iterator to the interval, true if it was inserted
+     */
+    std::pair<iterator, bool> insert( const Key_& lo, const Key_& hi ) {
+        return insert( value_type( lo, hi ) );
+    }
+
+    /**
+     * @brief Insert an interval
+     *
+     * @param value interval to be inserted
+     * @return std::pair<iterator, bool> iterator to the interval, true if it was inserted
+     */
+    std::pair<iterator, bool> insert( const value_type& value ) {
+        if ( compare_( value.second, value.first ) )
+            throw std::invalid_argument( "interval_set: interval end is before its start" );
+
+        node_pointer_ parent = header_;
+        node_pointer_ x      = header_->parent_;
+        bool go_left         = true;
+        while ( x != nullptr ) {
+            parent = x;
+            if ( less( value, x->key_ ) ) {
+                x       = x->left_;
+                go_left = true;
+            } else if ( less( x->key_, value ) ) {
+                x       = x->right_;
+                go_left = false;
+            } else
+                return std::make_pair( iterator( x ), false );
+        }
+
+        node_pointer_ inserted_node = make_node_holder( value ).release();
+        inserted_node->parent_      = parent;
+        if ( parent == header_ ) {
+            header_->parent_ = inserted_node;
+            header_->left_   = inserted_node;
+            header_->right_  = inserted_node;
+        } else {
+            if ( go_left )
+                parent->left_ = inserted_node;
+            else
+                parent->right_ = inserted_node;
+            if ( less( value, header_->left_->key_ ) ) header_->left_ = inserted_node;
+            if ( less( header_->right_->key_, value ) ) header_->right_ = inserted_node;
+            for ( node_pointer_ p = parent; p != header_; p = p->parent_ ) {
+                if ( !compare_( p->max_, value.second ) ) break;
+                p->max_ = value.second;
+            }
+            while ( inserted_node->parent_ != header_ &&
+                    inserted_node->parent_->priority_ < inserted_node->priority_ ) {
+                if ( inserted_node == inserted_node->parent_->left_ )
+                    rotate_right( inserted_node->parent_ );
+                else
+                    rotate_left( inserted_node->parent_ );
+            }
+        }
+        size_++;
+        return std::make_pair( iterator( inserted_node ), true );
+    }
+
+    /**
+     * @brief erases interval at the given position
+     *
+     * @param pos iterator to the interval
+     * @return iterator iterator to the interval following the erased one
+     */
+    iterator erase( const_iterator pos ) {
+        node_pointer_ x = pos.pointee_;
+        iterator next( x );
+        ++next;
+
+        // rotate x down until it has at most one child, then splice it out
+        while ( x->left_ != nullptr && x->right_ != nullptr ) {
+            if ( x->left_->priority_ > x->right_->priority_ )
+                rotate_right( x );
+            else
+                rotate_left( x );
+        }
+        node_pointer_ child  = x->left_ != nullptr ? x->left_ : x->right_;
+        node_pointer_ parent = x->parent_;
+        if ( child != nullptr ) child->parent_ = parent;
+        if ( parent == header_ )
+            header_->parent_ = child;
+        else if ( x == parent->left_ )
+            parent->left_ = child;
+        else
+            parent->right_ = child;
+        for ( node_pointer_ p = parent; p != header_; p = p->parent_ )
+            update_max( p );
+
+        size_--;
+        if ( size_ == 0 ) {
+            header_->left_  = header_;
+            header_->right_ = header_;
+        } else {
+            if ( x == header_->left_ ) header_->left_ = tree_min( header_->parent_ );
+            if ( x == header_->right_ ) header_->right_ = tree_max( header_->parent_ );
+        }
+        delete_node( x );
+        return next;
+    }
+
+    /**
+     * @brief erases the given interval
+     *
+     * @param key interval to erase
+     * @return size_type number of intervals erased (0 or 1)
+     */
+    size_type erase( const key_type& key ) {
+        const_iterator pos = find( key );
+        if ( pos == cend() ) return 0;
+        erase( pos );
+        return 1;
+    }
+
+    /**
+     * @brief clears the contents
+     *
+     */
+    void clear() noexcept {
+        detached_nodes released_( nat_, header_->parent_, size_ );
+        header_->parent_ = nullptr;
+        header_->left_   = header_;
+        header_->right_  = header_;
+        size_            = 0;
+    }
+
+    // Lookup
+    /**
+     * @brief Find the given interval
+     *
+     * @param key interval to find
+     * @return const_iterator iterator to the interval, end() if not present
+     */
+    const_iterator find( const key_type& key ) const {
+        node_pointer_ x = header_->parent_;
+        while ( x != nullptr ) {
+            if ( less( key, x->key_ ) )
+                x = x->left_;
+            else if ( less( x->key_, key ) )
+                x = x->right_;
+            else
+                return const_iterator( x );
+        }
+        return cend();
+    }
+
+    /**
+     * @brief All the intervals overlapping [lo, hi], in order. The range is lazy: finding the
+     * first interval takes O(log n) expected and every increment resumes the search from the
+     * current interval, skipping subtrees whose max endpoint is before lo
+     *
+     * @param lo start of the query interval
+     * @param hi end of the query interval
+     * @return overlap_range range of the overlapping intervals
+     */
+    overlap_range overlapping( const Key_& lo, const Key_& hi ) const {
+        overlap_iterator last( this, header_, lo, hi );
+        if ( compare_( hi, lo ) ) return overlap_range( last, last );
+        node_pointer_ first = first_overlap( header_->parent_, lo, hi );
+        return overlap_range( overlap_iterator( this, first != nullptr ? first : header_, lo, hi ),
+                              last );
+    }
+
+    /**
+     * @brief checks whether any interval overlaps [lo, hi] in O(log n) expected
+     *
+     * @param lo start of the query interval
+     * @param hi end of the query interval
+     * @return true if some interval overlaps
+     */
+    bool any_overlap( const Key_& lo, const Key_& hi ) const {
+        if ( compare_( hi, lo ) ) return false;
+        return first_overlap( header_->parent_, lo, hi ) != nullptr;
+    }
+
+    // Observers
+    key_compare key_comp() const {
+        return compare_;
+    }
+
+    node_allocator_& get_allocator() noexcept {
+        return nat_;
+    }
+
+    // Constructors
+    /**
+     * @brief Construct a new interval set object
+     *  Default constructor
+     */
+    explicit interval_set( const Compare_& comp = Compare_(),
+                           const Allocator_& alloc = Allocator_() )
+        : compare_( comp ), nat_( node_allocator_( alloc ) ), size_( 0 ),
+          seed_( 2463534242u ), header_( make_node_holder( value_type{} ).release() ) {
+        this->header_->left_  = this->header_;
+        this->header_->right_ = this->header_;
+    }
+
+    interval_set( const interval_set& ) = delete;
+    interval_set& operator=( const interval_set& ) = delete;
+
+    // Destructors
+    ~interval_set() {
+        clear();
+        delete_node( header_ );
+    }
+
+private:
+    const key_compare compare_;
+    node_allocator_ nat_;
+    size_type size_;
+    std::uint32_t seed_;
+    node_pointer_ header_;
+
+    node_holder_ make_node_holder( const value_type& value ) {
+        node_holder_ nh_( nat_.allocate( 1 ), node_destructor_( nat_ ) );
+        node_traits_::construct( nat_, nh_.get(), value, next_priority() );
+        nh_.get_deleter().value_constructed_ = true;
+        return nh_;
+    }
+
+    void delete_node( node_pointer_ node ) {
+        node_traits_::destroy( nat_, std::addressof( *node ) );
+        node_traits_::deallocate( nat_, node, 1 );
+    }
+
+    /**
+     * @brief xorshift32, only used to draw treap priorities
+     *
+     * @return std::uint32_t next priority
+     */
+    std::uint32_t next_priority() noexcept {
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+        return seed_;
+    }
+
+    bool less( const value_type& lhs, const value_type& rhs ) const {
+        if ( compare_( lhs.first, rhs.first ) ) return true;
+        if ( compare_( rhs.first, lhs.first ) ) return false;
+        return compare_( lhs.second, rhs.second );
+    }
+
+    bool overlaps( node_pointer_ x, const Key_& lo, const Key_& hi ) const {
+        return !compare_( hi, x->key_.first ) && !compare_( x->key_.second, lo );
+    }
+
+    void update_max( node_pointer_ x ) {
+        x->max_ = x->key_.second;
+        if ( x->left_ != nullptr && compare_( x->max_, x->left_->max_ ) ) x->max_ = x->left_->max_;
+        if ( x->right_ != nullptr && compare_( x->max_, x->right_->max_ ) )
+            x->max_ = x->right_->max_;
+    }
+
+    void replace_child( node_pointer_ x, node_pointer_ y ) {
+        node_pointer_ parent = x->parent_;
+        y->parent_           = parent;
+        if ( parent == header_ )
+            header_->parent_ = y;
+        else if ( x == parent->left_ )
+            parent->left_ = y;
+        else
+            parent->right_ = y;
+    }
+
+    void rotate_left( node_pointer_ x ) {
+        node_pointer_ y = x->right_;
+        x->right_       = y->left_;
+        if ( y->left_ != nullptr ) y->left_->parent_ = x;
+        replace_child( x, y );
+        y->left_   = x;
+        x->parent_ = y;
+        update_max( x );
+        update_max( y );
+    }
+
+    void rotate_right( node_pointer_ x ) {
+        node_pointer_ y = x->left_;
+        x->left_        = y->right_;
+        if ( y->right_ != nullptr ) y->right_->parent_ = x;
+        replace_child( x, y );
+        y->right_  = x;
+        x->parent_ = y;
+        update_max( x );
+        update_max( y );
+    }
+
+    static node_pointer_ tree_min( node_pointer_ x ) noexcept {
+        while ( x->left_ != nullptr )
+            x = x->left_;
+        return x;
+    }
+
+    static node_pointer_ tree_max( node_pointer_ x ) noexcept {
+        while ( x->right_ != nullptr )
+            x = x->right_;
+        return x;
+    }
+
+    /**
+     * @brief first interval of the subtree x, in order, which overlaps [lo, hi]
+     * If the left subtree reaches lo it either holds an overlap or starts after hi, in which
+     * case so does everything to its right, so the search never has to backtrack.
+     *
+     * @return node_pointer_ the node, nullptr if there is none
+     */
+    node_pointer_ first_overlap( node_pointer_ x, const Key_& lo, const Key_& hi ) const {
+        while ( x != nullptr && !compare_( x->max_, lo ) ) {
+            if ( x->left_ != nullptr && !compare_( x->left_->max_, lo ) ) {
+                x = x->left_;
+            } else {
+                if ( compare_( hi, x->key_.first ) ) return nullptr;
+                if ( !compare_( x->key_.second, lo ) ) return x;
+                x = x->right_;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief next interval after x, in order, which overlaps [lo, hi]
+     *
+     * @return node_pointer_ the node, header_ if there is none
+     */
+    node_pointer_ next_overlap( node_pointer_ x, const Key_& lo, const Key_& hi ) const {
+        if ( x->right_ != nullptr && !compare_( x->right_->max_, lo ) ) {
+            node_pointer_ found = first_overlap( x->right_, lo, hi );
+            return found != nullptr ? found : header_;
+        }
+        node_pointer_ y = x->parent_;
+        while ( y != header_ ) {
+            if ( x == y->left_ ) {
+                // everything from y on starts at or after y
+                if ( compare_( hi, y->key_.first ) ) return header_;
+                if ( overlaps( y, lo, hi ) ) return y;
+                if ( y->right_ != nullptr && !compare_( y->right_->max_, lo ) ) {
+                    node_pointer_ found = first_overlap( y->right_, lo, hi );
+                    return found != nullptr ? found : header_;
+                }
+            }
+            x = y;
+            y = y->parent_;
+        }
+        return header_;
+    }
+}; // class interval_set
+} // namespace tlib
@@ -0,0 +1,590 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+
+#include "bst.h"
+
+namespace tlib {
+
+/**
+ * @brief Ordered set split by key ranges into independent bst shards, so writers touching
+ * different ranges do not contend.
+ * Shard i holds the keys in [splitter i - 1, splitter i). Every shard has its own lock and
+ * its own copy of the allocator. A shard which grows past twice its fair share (size() /
+ * Shards_) is split at its median; once Shards_ shards exist the two smallest neighbours are
+ * merged first to make room. Splits and merges hand whole subtrees from one shard to the
+ * other, so copies of the allocator must compare equal.
+ * The splitters and the shards form an immutable layout published through an atomic
+ * pointer, so operations on keys only take the lock of their shard. A layout change moves
+ * the keys of every shard it touches into new shards and marks the old ones retired; an
+ * operation which routed with the previous layout finds its shard retired once it gets the
+ * lock and routes again. The replaced layout and the retired shards are freed once every
+ * operation which could still see them has finished.
+ *
+ * @tparam Key_ The key to be stored
+ * @tparam Compare_ Comparator associated with the type Key
+ * @tparam Allocator_ Allocator to store the keys in the shards
+ * @tparam Shards_ maximum number of shards
+ */
+template<class Key_, class Compare_ = std::less<Key_>, class Allocator_ = std::allocator<Key_>,
+         std::size_t Shards_ = 16>
+class sharded_bst {
+    static_assert( Shards_ > 0, "sharded_bst needs at least one shard" );
+
+public:
+    using tree_type       = tlib::bst<Key_, Compare_, Allocator_>;
+    using key_type        = Key_;
+    using value_type      = Key_;
+    using size_type       = typename tree_type::size_type;
+    using difference_type = typename tree_type::difference_type;
+    using key_compare     = Compare_;
+    using allocator_type  = Allocator_;
+    using const_reference = const value_type&;
+
+    // shards smaller than this are never split
+    static constexpr size_type MIN_SPLIT_SIZE = 1024;
+    // a shard past MIN_SPLIT_SIZE compares itself to the total size every this many inserts
+    static constexpr size_type SPLIT_CHECK_INTERVAL = 64;
+
+private:
+    static constexpr std::size_t CACHE_LINE = 64;
+    // slots readers announce themselves in, threads are spread over them round robin
+    static constexpr std::size_t READER_SLOTS = 32;
+
+    struct shard_ {
+        shard_( const Compare_& comp, const Allocator_& alloc )
+            : tree_( comp, alloc ), retired_( false ), count_( 0 ) {}
+
+        size_type count() const noexcept {
+            return count_.load( std::memory_order_relaxed );
+        }
+
+        void update_count() noexcept {
+            count_.store( tree_.size(), std::memory_order_relaxed );
+        }
+
+        std::mutex lock_;
+        tree_type tree_;
+        // set under lock_ once a newer layout has moved the keys of the shard elsewhere
+        bool retired_;
+        // size() reads the count from every thread, keep it away from the tree and the lock
+        char before_count_[CACHE_LINE];
+        std::atomic<size_type> count_;
+        char after_count_[CACHE_LINE];
+    };
+
+    using shard_pointer_ = std::shared_ptr<shard_>;
+
+    struct layout_state_ {
+        // splitters_[i] is the smallest key of shard i + 1
+        std::vector<key_type> splitters_;
+        std::vector<shard_pointer_> shards_;
+
+        std::size_t shard_index( const key_type& key, const key_compare& compare ) const {
+            return std::upper_bound( splitters_.begin(), splitters_.end(), key, compare ) -
+                   splitters_.begin();
+        }
+
+        size_type size() const noexcept {
+            size_type total = 0;
+            for ( const auto& shard : shards_ )
+                total += shard->count();
+            return total;
+        }
+    };
+
+    // number of readers which entered in an even and in an odd epoch
+    struct reader_slot_ {
+        std::atomic<size_type> active_[2] = {{0}, {0}};
+        char pad_[CACHE_LINE];
+    };
+
+    /**
+     * @brief Keeps the current layout, and any layout loaded while it lives, from being
+     * freed until it is destroyed.
+     * The reader counts itself in the parity of the epoch it saw; writers start a new epoch
+     * after publishing a layout and wait until the count of the previous parity drains
+     * before freeing the layout they replaced
+     */
+    class read_section_ {
+    public:
+        explicit read_section_( const sharded_bst& set ) : set_( set ) {
+            reader_slot_& slot = set.readers_[reader_slot_index()];
+            for ( ;; ) {
+                size_type epoch = set.epoch_.load();
+                counter_        = &slot.active_[epoch & 1];
+                counter_->fetch_add( 1 );
+                if ( set.epoch_.load() == epoch ) break;
+                counter_->fetch_sub( 1, std::memory_order_release );
+            }
+            reload();
+        }
+
+        read_section_( const read_section_& ) = delete;
+        read_section_& operator=( const read_section_& ) = delete;
+
+        ~read_section_() {
+            counter_->fetch_sub( 1, std::memory_order_release );
+        }
+
+        const layout_state_& layout() const noexcept {
+            return *layout_;
+        }
+
+        /**
+         * @brief moves on to the layout published last
+         *
+         */
+        void reload() noexcept {
+            layout_ = set_.layout_.load();
+        }
+
+    private:
+        const sharded_bst& set_;
+        std::atomic<size_type>* counter_;
+        const layout_state_* layout_;
+    };
+
+    /**
+     * @brief Locks the live shard the key belongs to, routing again whenever the shard found
+     * was retired in the meantime
+     */
+    class locked_shard_ {
+    public:
+        locked_shard_( const sharded_bst& set, const key_type& key ) : section_( set ) {
+            for ( ;; ) {
+                index_  = section_.layout().shard_index( key, set.compare_ );
+                target_ = section_.layout().shards_[index_].get();
+                lock_   = std::unique_lock<std::mutex>( target_->lock_ );
+                if ( !target_->retired_ ) return;
+                // the layout retiring the shard was published before its lock was released
+                lock_.unlock();
+                section_.reload();
+            }
+        }
+
+        const layout_state_& layout() const noexcept {
+            return section_.layout();
+        }
+
+        shard_& shard() const noexcept {
+            return *target_;
+        }
+
+        std::size_t index() const noexcept {
+            return index_;
+        }
+
+    private:
+        read_section_ section_;
+        std::size_t index_;
+        shard_* target_;
+        std::unique_lock<std::mutex> lock_;
+    };
+
+public:
+    /**
+     * @brief Ordered iterator which walks the shards one after the other.
+     * It takes no locks, so it must not be used while the set is being modified
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = typename sharded_bst::value_type;
+        using difference_type   = typename sharded_bst::difference_type;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        reference operator*() const {
+            return *it_;
+        }
+
+        pointer operator->() const {
+            return std::addressof( *it_ );
+        }
+
+        const_iterator& operator++() {
+            ++it_;
+            skip_empty();
+            return *this;
+        }
+
+        const_iterator operator++( int ) {
+            auto temp_ = *this;
+            ++( *this );
+            return temp_;
+        }
+
+        friend bool operator==( const const_iterator& lhs, const const_iterator& rhs ) {
+            return lhs.shard_ == rhs.shard_ && lhs.it_ == rhs.it_;
+        }
+
+        friend bool operator!=( const const_iterator& lhs, const const_iterator& rhs ) {
+            return !( lhs == rhs );
+        }
+
+    private:
+        friend class sharded_bst;
+
+        const_iterator( const layout_state_* layout, std::size_t shard,
+                        typename tree_type::const_iterator it )
+            : layout_( layout ), shard_( shard ), it_( it ) {}
+
+        // moves past the end of a shard onto the first element of the next non-empty one
+        void skip_empty() {
+            while ( shard_ + 1 < layout_->shards_.size() &&
+                    it_ == layout_->shards_[shard_]->tree_.cend() ) {
+                ++shard_;
+                it_ = layout_->shards_[shard_]->tree_.cbegin();
+            }
+        }
+
+        const layout_state_* layout_;
+        std::size_t shard_;
+        typename tree_type::const_iterator it_;
+    };
+
+    using iterator = const_iterator;
+
+    // Iterators
+    /**
+     * @brief Returns an iterator to the first element(smallest value)
+     *
+     * @return const_iterator iterator to the first element
+     */
+    const_iterator begin() const {
+        const layout_state_* layout = layout_.load();
+        const_iterator first( layout, 0, layout->shards_.front()->tree_.cbegin() );
+        first.skip_empty();
+        return first;
+    }
+
+    /**
+     * @brief Returns an iterator to the end element. End is after the last element
+     *
+     * @return const_iterator iterator to the end element
+     */
+    const_iterator end() const {
+        const layout_state_* layout = layout_.load();
+        return const_iterator( layout, layout->shards_.size() - 1,
+                               layout->shards_.back()->tree_.cend() );
+    }
+
+    // Capacity
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    /**
+     * @brief returns the number of elements, summed over the counts of the shards
+     *
+     * @return size_type number of elements
+     */
+    size_type size() const noexcept {
+        read_section_ section( *this );
+        return section.layout().size();
+    }
+
+    /**
+     * @brief returns the current number of shards
+     *
+     * @return std::size_t number of shards
+     */
+    std::size_t shard_count() const {
+        read_section_ section( *this );
+        return section.layout().shards_.size();
+    }
+
+    // Modifiers
+    /**
+     * @brief Insert elements. Safe to call from several threads
+     *
+     * @param value value to be inserted
+     * @return true if the element was not present
+     */
+    bool insert( const value_type& value ) {
+        bool inserted    = false;
+        bool needs_split = false;
+        {
+            locked_shard_ locked( *this, value );
+            shard_& s = locked.shard();
+            inserted  = s.tree_.insert( value ).second;
+            if ( inserted ) {
+                s.update_count();
+                size_type count = s.tree_.size();
+                needs_split     = count % SPLIT_CHECK_INTERVAL == 0 &&
+                                  count > split_limit( locked.layout().size() );
+            }
+        }
+        if ( needs_split ) rebalance( value );
+        return inserted;
+    }
+
+    /**
+     * @brief erases the element with the given key. Safe to call from several threads
+     *
+     * @param key key of the element to erase
+     * @return size_type number of elements erased (0 or 1)
+     */
+    size_type erase( const key_type& key ) {
+        locked_shard_ locked( *this, key );
+        shard_& s        = locked.shard();
+        size_type erased = s.tree_.erase( key );
+        s.update_count();
+        return erased;
+    }
+
+    /**
+     * @brief clears the contents. The nodes are released after every lock has been dropped
+     *
+     */
+    void clear() {
+        std::vector<typename tree_type::detached_nodes> released;
+        std::lock_guard<std::mutex> writer( writer_lock_ );
+        const layout_state_& current = *layout_.load();
+        std::unique_ptr<layout_state_> next( new layout_state_ );
+        next->shards_.reserve( Shards_ );
+        next->shards_.push_back( make_shard() );
+        released.reserve( current.shards_.size() );
+        std::unique_ptr<const layout_state_> old;
+        {
+            std::vector<std::size_t> all( current.shards_.size() );
+            for ( std::size_t i = 0; i < all.size(); ++i )
+                all[i] = i;
+            auto locks = lock_shards( current, all );
+            for ( const auto& shard : current.shards_ ) {
+                tree_type& tree = shard->tree_;
+                released.push_back( tree.extract( tree.cbegin(), tree.cend() ) );
+                retire( *shard );
+            }
+            old.reset( layout_.exchange( next.release() ) );
+        }
+        wait_for_readers();
+    }
+
+    // Lookup
+    /**
+     * @brief checks whether the key is present. Safe to call from several threads
+     *
+     * @param key key to look for
+     * @return true if the key is present
+     */
+    bool contains( const key_type& key ) const {
+        locked_shard_ locked( *this, key );
+        tree_type& tree = locked.shard().tree_;
+        return tree.find( key ) != tree.end();
+    }
+
+    /**
+     * @brief Find the given key. Like iteration, the result is only meaningful while the
+     * set is not being modified
+     *
+     * @param key key to be find
+     * @return const_iterator iterator to the found key, end() if not present
+     */
+    const_iterator find( const key_type& key ) const {
+        locked_shard_ locked( *this, key );
+        tree_type& tree                       = locked.shard().tree_;
+        typename tree_type::const_iterator it = tree.find( key );
+        if ( it == tree.cend() ) return end();
+        return const_iterator( &locked.layout(), locked.index(), it );
+    }
+
+    // Observers
+    key_compare key_comp() const {
+        return compare_;
+    }
+
+    // Constructors
+    /**
+     * @brief Construct a new sharded bst object with a single shard
+     *  Default constructor
+     */
+    explicit sharded_bst( const Compare_& comp   = Compare_(),
+                          const Allocator_& alloc = Allocator_() )
+        : compare_( comp ), alloc_( alloc ), layout_( nullptr ), epoch_( 0 ) {
+        std::unique_ptr<layout_state_> layout( new layout_state_ );
+        layout->shards_.reserve( Shards_ );
+        layout->shards_.push_back( make_shard() );
+        layout_.store( layout.release() );
+    }
+
+    sharded_bst( const sharded_bst& ) = delete;
+    sharded_bst& operator=( const sharded_bst& ) = delete;
+
+    // Destructors
+    ~sharded_bst() {
+        delete layout_.load();
+    }
+
+private:
+    const key_compare compare_;
+    const allocator_type alloc_;
+    std::atomic<const layout_state_*> layout_;
+    // bumped by writers after publishing a layout
+    std::atomic<size_type> epoch_;
+    mutable reader_slot_ readers_[READER_SLOTS];
+    // serializes layout changes, never taken by operations on keys
+    std::mutex writer_lock_;
+
+    static std::size_t reader_slot_index() {
+        static std::atomic<std::size_t> next_slot( 0 );
+        thread_local std::size_t slot =
+            next_slot.fetch_add( 1, std::memory_order_relaxed ) % READER_SLOTS;
+        return slot;
+    }
+
+    static size_type split_limit( size_type total ) noexcept {
+        size_type limit = 2 * total / Shards_;
+        if ( limit < MIN_SPLIT_SIZE ) return MIN_SPLIT_SIZE;
+        return limit;
+    }
+
+    shard_pointer_ make_shard() const {
+        return std::make_shared<shard_>( compare_, alloc_ );
+    }
+
+    /**
+     * @brief locks the given shards of a layout in index order, so that writers never
+     * deadlock on each other
+     *
+     * @param layout layout the shards belong to
+     * @param indices indices of the shards to lock
+     * @return std::vector<std::unique_lock<std::mutex>> the locks held
+     */
+    static std::vector<std::unique_lock<std::mutex>>
+    lock_shards( const layout_state_& layout, std::vector<std::size_t> indices ) {
+        std::sort( indices.begin(), indices.end() );
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve( indices.size() );
+        for ( std::size_t i : indices )
+            locks.emplace_back( layout.shards_[i]->lock_ );
+        return locks;
+    }
+
+    /**
+     * @brief marks a shard whose keys have moved to a newer layout, its lock must be held
+     *
+     */
+    static void retire( shard_& shard ) noexcept {
+        shard.retired_ = true;
+        shard.update_count();
+    }
+
+    /**
+     * @brief starts a new epoch and waits until every reader which entered in the previous
+     * one has left. Readers which entered before that can not exist, since the writer which
+     * started the previous epoch waited for them
+     *
+     */
+    void wait_for_readers() {
+        size_type previous = epoch_.load( std::memory_order_relaxed );
+        epoch_.store( previous + 1 );
+        for ( const reader_slot_& slot : readers_ )
+            while ( slot.active_[previous & 1].load() != 0 )
+                std::this_thread::yield();
+    }
+
+    /**
+     * @brief splits the shard holding key if it is still oversized, merging the two smallest
+     * neighbouring shards first when the shard limit has been reached
+     *
+     * @param key key whose shard grew
+     */
+    void rebalance( const key_type& key ) {
+        std::lock_guard<std::mutex> writer( writer_lock_ );
+        const layout_state_& current = *layout_.load();
+        std::size_t shards           = current.shards_.size();
+        size_type total              = current.size();
+        std::size_t i                = current.shard_index( key, compare_ );
+        if ( current.shards_[i]->count() <= split_limit( total ) ) return;
+
+        std::size_t smallest = shards;
+        if ( shards == Shards_ ) {
+            if ( Shards_ < 3 ) return;
+            size_type pair_size = 0;
+            for ( std::size_t j = 0; j + 1 < shards; ++j ) {
+                if ( j == i || j + 1 == i ) continue;
+                size_type s = current.shards_[j]->count() + current.shards_[j + 1]->count();
+                if ( smallest == shards || s < pair_size ) {
+                    smallest  = j;
+                    pair_size = s;
+                }
+            }
+            // merging only pays off when the pair together is still below average
+            if ( smallest == shards || pair_size * shards > total ) return;
+        }
+
+        std::unique_ptr<layout_state_> next( new layout_state_( current ) );
+        next->shards_.reserve( Shards_ + 1 );
+        std::vector<std::size_t> changed = {i};
+        if ( smallest != shards ) {
+            changed.push_back( smallest );
+            changed.push_back( smallest + 1 );
+        }
+        std::unique_ptr<const layout_state_> old;
+        {
+            auto locks = lock_shards( current, changed );
+            if ( smallest != shards ) {
+                merge_shards( *next, smallest );
+                if ( smallest < i ) --i;
+            }
+            split_shard( *next, i );
+            old.reset( layout_.exchange( next.release() ) );
+        }
+        wait_for_readers();
+    }
+
+    /**
+     * @brief moves the two halves of shard i into new shards i and i + 1. Each half is cut
+     * out and linked into its new shard as a whole, so no key is copied and no node is
+     * allocated or freed. The lower half moves too, so that operations which routed with
+     * the old layout find the shard retired instead of missing the keys of the upper half
+     *
+     */
+    void split_shard( layout_state_& next, std::size_t i ) {
+        shard_pointer_ old = next.shards_[i];
+        tree_type& tree    = old->tree_;
+        auto median        = tree.nth( tree.size() / 2 );
+
+        shard_pointer_ lower = make_shard();
+        shard_pointer_ upper = make_shard();
+        next.splitters_.insert( next.splitters_.begin() + i, *median );
+        next.shards_.insert( next.shards_.begin() + i + 1, upper );
+        next.shards_[i] = lower;
+        upper->tree_.adopt( tree.extract( median, tree.cend() ) );
+        lower->tree_.adopt( tree.extract( tree.cbegin(), tree.cend() ) );
+        lower->update_count();
+        upper->update_count();
+        retire( *old );
+    }
+
+    /**
+     * @brief moves shards i and i + 1 into a single new shard i by linking their trees in
+     *
+     */
+    void merge_shards( layout_state_& next, std::size_t i ) {
+        shard_pointer_ lower  = next.shards_[i];
+        shard_pointer_ upper  = next.shards_[i + 1];
+        shard_pointer_ merged = make_shard();
+        next.splitters_.erase( next.splitters_.begin() + i );
+        next.shards_.erase( next.shards_.begin() + i + 1 );
+        next.shards_[i] = merged;
+        merged->tree_.adopt( lower->tree_.extract( lower->tree_.cbegin(), lower->tree_.cend() ) );
+        merged->tree_.adopt( upper->tree_.extract( upper->tree_.cbegin(), upper->tree_.cend() ) );
+        merged->update_count();
+        retire( *lower );
+        retire( *upper );
+    }
+}; // class sharded_bst
+} // namespace tlib
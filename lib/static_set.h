@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "config.h"
+
+namespace tlib {
+
+/**
+ * @brief Fixed ordered set whose contents are known at compile time. The keys are sorted
+ * and deduplicated by the constexpr constructor into a plain array, so a constexpr
+ * static_set needs no allocation or initialization at run time. Lookups are binary searches
+ * over the array and the interface mirrors the lookup and iteration part of bst
+ *
+ * @tparam Key_ The key to be stored, a literal type
+ * @tparam N_ most keys the set can hold
+ * @tparam Compare_ Comparator associated with the type Key, usable in constant expressions
+ */
+template<class Key_, std::size_t N_, class Compare_ = std::less<Key_>> class static_set {
+public:
+    using key_type        = Key_;
+    using value_type      = Key_;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using key_compare     = Compare_;
+    using value_compare   = Compare_;
+    using reference       = value_type&;
+    using const_reference = const value_type&;
+    using pointer         = value_type*;
+    using const_pointer   = const value_type*;
+    using iterator        = const value_type*;
+    using const_iterator  = const value_type*;
+
+    // Constructors
+    /**
+     * @brief Construct a new static set object from at most N_ keys, duplicates allowed
+     *
+     * @param keys keys of the set, in any order
+     * @param comp comparator
+     */
+    constexpr static_set( std::initializer_list<Key_> keys, const Compare_& comp = Compare_() )
+        : compare_( comp ), keys_{}, size_( 0 ) {
+        if ( keys.size() > N_ ) throw std::length_error( "static_set: too many keys" );
+        for ( const Key_& key : keys )
+            insert_sorted( key );
+    }
+
+    /**
+     * @brief Construct a new static set object from an array of keys, duplicates allowed
+     *
+     * @param keys keys of the set, in any order
+     * @param comp comparator
+     */
+    constexpr static_set( const Key_ ( &keys )[N_], const Compare_& comp = Compare_() )
+        : compare_( comp ), keys_{}, size_( 0 ) {
+        for ( std::size_t i = 0; i < N_; ++i )
+            insert_sorted( keys[i] );
+    }
+
+    // Iterators
+    /**
+     * @brief Returns an iterator to the first element(smallest value)
+     *
+     * @return const_iterator iterator to the first element
+     */
+    constexpr const_iterator begin() const noexcept {
+        return keys_;
+    }
+
+    constexpr const_iterator cbegin() const noexcept {
+        return keys_;
+    }
+
+    /**
+     * @brief Returns an iterator to the end element. End is after the last element
+     *
+     * @return const_iterator iterator to the end element
+     */
+    constexpr const_iterator end() const noexcept {
+        return keys_ + size_;
+    }
+
+    constexpr const_iterator cend() const noexcept {
+        return keys_ + size_;
+    }
+
+    // Capacity
+    constexpr bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    constexpr size_type size() const noexcept {
+        return size_;
+    }
+
+    constexpr size_type max_size() const noexcept {
+        return N_;
+    }
+
+    // Lookup
+    /**
+     * @brief Returns an iterator to the first element not less than the given key
+     *
+     * @param x key to compare the elements to
+     * @return const_iterator iterator to the element, end() if there is none
+     */
+    constexpr const_iterator lower_bound( const key_type& x ) const {
+        size_type first = 0;
+        size_type count = size_;
+        while ( count > 0 ) {
+            size_type half = count / 2;
+            if ( compare_( keys_[first + half], x ) ) {
+                first += half + 1;
+                count -= half + 1;
+            } else
+                count = half;
+        }
+        return keys_ + first;
+    }
+
+    /**
+     * @brief Find the given key
+     *
+     * @param x key to be find
+     * @return const_iterator iterator to the found key, end() if not present
+     */
+    constexpr const_iterator find( const key_type& x ) const {
+        const_iterator it = lower_bound( x );
+        return it != end() && !compare_( x, *it ) ? it : end();
+    }
+
+    /**
+     * @brief checks whether the key is present
+     *
+     * @param x key to look for
+     * @return true if the key is present
+     */
+    constexpr bool contains( const key_type& x ) const {
+        return find( x ) != end();
+    }
+
+    // Observers
+    constexpr key_compare key_comp() const {
+        return compare_;
+    }
+
+    constexpr key_compare value_comp() const {
+        return compare_;
+    }
+
+private:
+    Compare_ compare_;
+    Key_ keys_[N_ > 0 ? N_ : 1];
+    size_type size_;
+
+    /**
+     * @brief insertion sort step, skipping keys already present
+     *
+     */
+    constexpr void insert_sorted( const Key_& key ) {
+        size_type pos = size_;
+        while ( pos > 0 && compare_( key, keys_[pos - 1] ) )
+            --pos;
+        if ( pos > 0 && !compare_( keys_[pos - 1], key ) ) return;
+        for ( size_type i = size_; i > pos; --i )
+            keys_[i] = keys_[i - 1];
+        keys_[pos] = key;
+        ++size_;
+    }
+};
+
+/**
+ * @brief Builds a static_set from an array, deducing its capacity
+ *
+ * @param keys keys of the set, in any order
+ * @return static_set<Key_, N_> the set
+ */
+template<class Key_, std::size_t N_>
+constexpr static_set<Key_, N_> make_static_set( const Key_ ( &keys )[N_] ) {
+    return static_set<Key_, N_>( keys );
+}
+} // namespace tlib
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "lib/bst.h"
+#include "test/counting_allocator.h"
+
+TEST( BST, FIND_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30} )
+        input.insert( i );
+    ASSERT_EQ( 30, *input.find( 30 ) );
+    ASSERT_TRUE( input.find( 35 ) == input.end() );
+    ASSERT_TRUE( input.find( 70 ) == input.end() );
+}
+
+TEST( BST, BUFFERED_INSERT_READ_FLUSHES_TEST ) {
+    tlib::bst<int> input;
+    input.set_insert_buffer( 8 );
+    ASSERT_EQ( 8, input.insert_buffer() );
+    input.insert_buffered( 42 );
+    ASSERT_TRUE( input.contains( 42 ) );
+    ASSERT_EQ( 0, input.staged() );
+    input.insert_buffered( 30 );
+    ASSERT_EQ( 30, *input.find( 30 ) );
+    input.insert_buffered( 10 );
+    input.insert_buffered( 30 );
+    ASSERT_EQ( 10, *input.lower_bound( 5 ) );
+    input.insert_buffered( 20 );
+    ASSERT_EQ( ( std::vector<int>{10, 20, 30, 42} ),
+               std::vector<int>( input.begin(), input.end() ) );
+    ASSERT_EQ( 4, input.size() );
+    input.insert_buffered( 5 );
+    ASSERT_FALSE( input.insert( 5 ).second );
+}
+
+TEST( BST, BUFFERED_INSERT_CONST_READS_TEST ) {
+    tlib::bst<int> input;
+    input.set_insert_buffer( 8 );
+    input.insert( 1 );
+    input.insert_buffered( 2 );
+    const tlib::bst<int>& view = input;
+    // const reads leave the tree alone; contains also looks at the staged values
+    ASSERT_TRUE( view.contains( 2 ) );
+    ASSERT_FALSE( view.contains( 3 ) );
+    ASSERT_EQ( 1, view.staged() );
+    ASSERT_EQ( 1, view.size() );
+    input.flush();
+    ASSERT_EQ( 0, view.staged() );
+    ASSERT_EQ( 2, view.size() );
+    ASSERT_EQ( 2, *view.find( 2 ) );
+}
+
+TEST( BST, BUFFERED_INSERT_ITERATORS_STAY_VALID_TEST ) {
+    tlib::bst<int> input;
+    input.set_insert_buffer( 4 );
+    for ( int i : {1, 3, 5} )
+        input.insert( i );
+    auto it = input.find( 3 );
+    for ( int i : {2, 4, 6, 0} )
+        input.insert_buffered( i );
+    ASSERT_EQ( 3, *it );
+    ASSERT_EQ( 4, *( ++it ) );
+}
+
+TEST( BST, BUFFERED_INSERT_RANDOMIZED_TEST ) {
+    std::mt19937 gen( 7 );
+    std::uniform_int_distribution<int> keys( 0, 5000 );
+    for ( tlib::bst<int>::size_type threshold : {1, 3, 64, 1000} ) {
+        tlib::bst<int> input;
+        std::set<int> expected;
+        input.set_insert_buffer( threshold );
+        for ( int round = 0; round < 4000; ++round ) {
+            int key = keys( gen );
+            input.insert_buffered( key );
+            expected.insert( key );
+            if ( round % 997 == 0 ) {
+                input.flush();
+                ASSERT_EQ( expected.size(), input.size() );
+            }
+        }
+        input.flush();
+        ASSERT_EQ( expected.size(), input.size() );
+        ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ),
+                   std::vector<int>( input.begin(), input.end() ) );
+        auto erased = std::distance( expected.begin(), expected.lower_bound( 1000 ) );
+        ASSERT_EQ( erased, input.erase_range( 0, 1000 ) );
+    }
+}
+
+TEST( BST, BUFFERED_INSERT_CLEAR_TEST ) {
+    tlib::bst<std::string> input;
+    input.set_insert_buffer( 16 );
+    input.insert_buffered( "b" );
+    input.insert_buffered( std::string( "a" ) );
+    input.clear();
+    ASSERT_TRUE( input.empty() );
+    input.insert_buffered( "c" );
+    input.set_insert_buffer( 0 );
+    ASSERT_EQ( 1, input.size() );
+    ASSERT_EQ( "c", *input.begin() );
+}
+
+TEST( BST, BUFFERED_INSERT_THROWING_MERGE_KEEPS_VALUES_TEST ) {
+    using tree_type = tlib::bst<std::string, std::less<std::string>,
+                                tlib_test::counting_allocator<std::string>>;
+    long& allocations_left = tlib_test::allocation_counter::single_allocations_left();
+    // a batch large next to the tree takes the linear merge, a small one is inserted one by one
+    for ( int existing : {2, 200} ) {
+        tree_type input;
+        std::set<std::string> expected;
+        for ( int i = 0; i < existing; ++i ) {
+            input.insert( "key" + std::to_string( 2 * i ) );
+            expected.insert( "key" + std::to_string( 2 * i ) );
+        }
+        input.set_insert_buffer( 16 );
+        for ( int i = 0; i < 6; ++i ) {
+            input.insert_buffered( "key" + std::to_string( 2 * i + 1 ) );
+            expected.insert( "key" + std::to_string( 2 * i + 1 ) );
+        }
+        allocations_left = 2;
+        ASSERT_THROW( input.flush(), std::bad_alloc );
+        allocations_left = -1;
+        ASSERT_EQ( existing + 2, input.size() );
+        ASSERT_EQ( 4, input.staged() );
+        input.flush();
+        ASSERT_EQ( std::vector<std::string>( expected.begin(), expected.end() ),
+                   std::vector<std::string>( input.begin(), input.end() ) );
+    }
+}
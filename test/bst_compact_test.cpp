@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "lib/bst.h"
+#include "test/counting_allocator.h"
+
+namespace {
+template<class Key_> std::vector<Key_> contents( const tlib::bst<Key_>& input ) {
+    return std::vector<Key_>( input.begin(), input.end() );
+}
+} // namespace
+
+TEST( BST, COMPACT_KEEPS_CONTENTS_TEST ) {
+    std::mt19937 gen( 5 );
+    std::uniform_int_distribution<int> keys( 0, 100000 );
+    tlib::bst<int> input;
+    std::set<int> expected;
+    for ( int i = 0; i < 3000; ++i ) {
+        int key = keys( gen );
+        input.insert( key );
+        expected.insert( key );
+    }
+    input.compact();
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+
+    // the compacted tree stays fully usable
+    for ( int i = 0; i < 3000; ++i ) {
+        int key = keys( gen );
+        if ( i % 2 )
+            ASSERT_EQ( expected.erase( key ), input.erase( key ) );
+        else
+            ASSERT_EQ( expected.insert( key ).second, input.insert( key ).second );
+    }
+    ASSERT_EQ( expected.erase( *expected.begin() ), input.erase( *input.begin() ) );
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+    input.compact();
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+    ASSERT_EQ( expected.size(), input.erase_range( 0, 100001 ) );
+    ASSERT_TRUE( input.empty() );
+}
+
+TEST( BST, COMPACT_INCREMENTAL_TEST ) {
+    tlib::bst<std::string> input;
+    std::set<std::string> expected;
+    for ( int i = 0; i < 500; ++i ) {
+        std::string key = std::to_string( ( i * 7919 ) % 1000 );
+        input.insert( key );
+        expected.insert( key );
+    }
+    int steps = 0;
+    while ( !input.compact_step( 16 ) )
+        ++steps;
+    ASSERT_GE( steps, 500 / 16 - 1 );
+    ASSERT_EQ( std::vector<std::string>( expected.begin(), expected.end() ), contents( input ) );
+
+    ASSERT_TRUE( input.compact_step( 10 ) );
+
+    // modifying the tree between steps restarts the compaction, which only has to move the
+    // nodes that are not in the slab yet
+    input.insert( "new" );
+    expected.insert( "new" );
+    ASSERT_TRUE( input.compact_step( 1 ) );
+    for ( int i = 0; i < 20; ++i ) {
+        input.insert( "newer" + std::to_string( i ) );
+        expected.insert( "newer" + std::to_string( i ) );
+    }
+    ASSERT_FALSE( input.compact_step( 10 ) );
+    ASSERT_TRUE( input.compact_step( 10 ) );
+    input.erase( "new" );
+    expected.erase( "new" );
+    input.compact();
+    ASSERT_EQ( std::vector<std::string>( expected.begin(), expected.end() ), contents( input ) );
+}
+
+TEST( BST, COMPACT_EXTRACTED_NODES_OUTLIVE_TREE_TEST ) {
+    tlib::bst<std::string>::detached_nodes released;
+    {
+        tlib::bst<std::string> input;
+        for ( int i = 0; i < 100; ++i )
+            input.insert( "key" + std::to_string( 100 + i ) );
+        input.compact();
+        released = input.extract_range( "key120", "key150" );
+        ASSERT_EQ( 70, input.size() );
+        input.compact();
+    }
+    ASSERT_EQ( 30, released.size() );
+    released.release();
+}
+
+TEST( BST, COMPACT_EMPTY_TEST ) {
+    tlib::bst<int> input;
+    ASSERT_TRUE( input.compact_step( 1 ) );
+    input.compact();
+    input.insert( 1 );
+    input.compact();
+    ASSERT_EQ( 1, *input.begin() );
+    input.clear();
+    input.compact();
+    ASSERT_TRUE( input.empty() );
+}
+
+TEST( BST, COMPACT_STEPS_BETWEEN_WRITES_STAY_BOUNDED_TEST ) {
+    using tree_type = tlib::bst<int, std::less<int>, tlib_test::counting_allocator<int>>;
+    const std::size_t& live_bytes = tlib_test::allocation_counter::live_bytes();
+    std::size_t before            = live_bytes;
+    std::mt19937 gen( 11 );
+    std::uniform_int_distribution<int> keys( 0, 1 << 30 );
+    {
+        tree_type input;
+        std::vector<int> present;
+        while ( present.size() < 4000 ) {
+            int key = keys( gen );
+            if ( input.insert( key ).second ) present.push_back( key );
+        }
+        std::size_t built = live_bytes - before;
+        std::size_t peak  = 0;
+        for ( int round = 0; round < 1000; ++round ) {
+            input.compact_step( 400 );
+            int& victim = present[gen() % present.size()];
+            ASSERT_EQ( 1, input.erase( victim ) );
+            do {
+                victim = keys( gen );
+            } while ( !input.insert( victim ).second );
+            peak = std::max( peak, live_bytes - before );
+        }
+        ASSERT_LE( peak, 3 * built );
+        input.compact();
+        ASSERT_LE( live_bytes - before, 2 * built );
+        std::sort( present.begin(), present.end() );
+        ASSERT_EQ( present, std::vector<int>( input.begin(), input.end() ) );
+    }
+    ASSERT_EQ( before, live_bytes );
+}
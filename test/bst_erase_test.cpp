@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+std::vector<int> contents( const tlib::bst<int>& input ) {
+    return std::vector<int>( input.begin(), input.end() );
+}
+} // namespace
+
+TEST( BST, CLEAR_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70} )
+        input.insert( i );
+    ASSERT_EQ( 7, input.size() );
+    input.clear();
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.begin() == input.end() );
+    ASSERT_EQ( *( input.insert( 5 ).first ), 5 );
+    ASSERT_EQ( 1, input.size() );
+}
+
+TEST( BST, ITERATOR_UNSORTED_INSERT_TEST ) {
+    tlib::bst<int> input;
+    std::set<int> expected;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70, 20, 65} ) {
+        ASSERT_EQ( expected.insert( i ).second, input.insert( i ).second );
+    }
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+}
+
+TEST( BST, ERASE_RANGE_MIDDLE_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70, 25, 35, 45} )
+        input.insert( i );
+    ASSERT_EQ( 5, input.erase_range( 25, 46 ) );
+    ASSERT_EQ( 5, input.size() );
+    ASSERT_EQ( ( std::vector<int>{10, 20, 50, 60, 70} ), contents( input ) );
+}
+
+TEST( BST, ERASE_RANGE_PREFIX_SUFFIX_TEST ) {
+    tlib::bst<int> input;
+    for ( int i = 0; i < 100; ++i )
+        input.insert( ( i * 37 ) % 100 );
+    ASSERT_EQ( 30, input.erase_range( -5, 30 ) );
+    ASSERT_EQ( 30, *input.begin() );
+    ASSERT_EQ( 20, input.erase_range( 80, 1000 ) );
+    ASSERT_EQ( 50, input.size() );
+    std::vector<int> expected;
+    for ( int i = 30; i < 80; ++i )
+        expected.push_back( i );
+    ASSERT_EQ( expected, contents( input ) );
+    ASSERT_EQ( 0, input.erase_range( 50, 50 ) );
+    ASSERT_EQ( 50, input.erase_range( 0, 100 ) );
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.begin() == input.end() );
+}
+
+TEST( BST, ERASE_ITERATOR_RANGE_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70} )
+        input.insert( i );
+    auto first = input.cbegin();
+    ++first;
+    auto last = first;
+    ++last;
+    ++last;
+    auto next = input.erase( first, last );
+    ASSERT_EQ( 40, *next );
+    ASSERT_EQ( ( std::vector<int>{10, 40, 50, 60, 70} ), contents( input ) );
+    next = input.erase( input.cbegin(), input.cend() );
+    ASSERT_TRUE( next == input.end() );
+    ASSERT_TRUE( input.empty() );
+}
+
+TEST( BST, EXTRACT_RANGE_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70} )
+        input.insert( i );
+    auto released = input.extract_range( 20, 55 );
+    ASSERT_EQ( 4, released.size() );
+    ASSERT_EQ( 3, input.size() );
+    ASSERT_EQ( ( std::vector<int>{10, 60, 70} ), contents( input ) );
+    released.release();
+    ASSERT_TRUE( released.empty() );
+}
+
+TEST( BST, NTH_TEST ) {
+    tlib::bst<int> input;
+    ASSERT_TRUE( input.nth( 0 ) == input.end() );
+    for ( int i : {40, 20, 60, 10, 30, 50, 70} )
+        input.insert( i );
+    input.erase( 40 );
+    std::vector<int> expected = {10, 20, 30, 50, 60, 70};
+    for ( std::size_t n = 0; n < expected.size(); ++n )
+        ASSERT_EQ( expected[n], *input.nth( n ) );
+    ASSERT_TRUE( input.nth( expected.size() ) == input.end() );
+}
+
+TEST( BST, EXTRACT_ADOPT_TEST ) {
+    tlib::bst<int> lower;
+    tlib::bst<int> upper;
+    for ( int i = 0; i < 100; ++i )
+        lower.insert( ( i * 37 ) % 100 );
+    upper.adopt( lower.extract( lower.nth( 60 ), lower.cend() ) );
+    ASSERT_EQ( 60, lower.size() );
+    ASSERT_EQ( 59, *lower.nth( 59 ) );
+    for ( int i = 200; i < 210; ++i )
+        upper.insert( i );
+    ASSERT_EQ( 50, upper.size() );
+    ASSERT_EQ( 60, *upper.begin() );
+    ASSERT_EQ( 209, *upper.nth( 49 ) );
+    lower.adopt( upper.extract( upper.cbegin(), upper.cend() ) );
+    ASSERT_TRUE( upper.empty() );
+    ASSERT_TRUE( upper.begin() == upper.end() );
+    ASSERT_EQ( 110, lower.size() );
+    std::vector<int> expected;
+    for ( int i = 0; i < 100; ++i )
+        expected.push_back( i );
+    for ( int i = 200; i < 210; ++i )
+        expected.push_back( i );
+    ASSERT_EQ( expected, contents( lower ) );
+    lower.insert( 150 );
+    ASSERT_EQ( 150, *lower.nth( 100 ) );
+    ASSERT_EQ( 111, lower.erase_range( 0, 1000 ) );
+}
+
+TEST( BST, ERASE_KEY_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30, 50, 70, 25, 35} )
+        input.insert( i );
+    ASSERT_EQ( 1, input.erase( 20 ) );
+    ASSERT_EQ( 0, input.erase( 20 ) );
+    ASSERT_EQ( 1, input.erase( 10 ) );
+    ASSERT_EQ( 1, input.erase( 70 ) );
+    ASSERT_EQ( 1, input.erase( 40 ) );
+    ASSERT_EQ( ( std::vector<int>{25, 30, 35, 50, 60} ), contents( input ) );
+    auto next = input.erase( input.find( 30 ) );
+    ASSERT_EQ( 35, *next );
+    for ( int i : {25, 35, 50, 60} )
+        ASSERT_EQ( 1, input.erase( i ) );
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.begin() == input.end() );
+}
+
+TEST( BST, ERASE_KEY_RANDOMIZED_TEST ) {
+    std::mt19937 gen( 11 );
+    std::uniform_int_distribution<int> keys( 0, 300 );
+    tlib::bst<int> input;
+    std::set<int> expected;
+    for ( int round = 0; round < 5000; ++round ) {
+        int key = keys( gen );
+        if ( round % 2 )
+            ASSERT_EQ( expected.erase( key ), input.erase( key ) );
+        else
+            ASSERT_EQ( expected.insert( key ).second, input.insert( key ).second );
+    }
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+}
+
+TEST( BST, EXTRACT_RANGE_COUNTS_RANDOMIZED_TEST ) {
+    std::mt19937 gen( 23 );
+    std::uniform_int_distribution<int> keys( 0, 4000 );
+    tlib::bst<int> input;
+    std::set<int> expected;
+    input.set_insert_buffer( 64 );
+    // every way of changing the shape has to keep the subtree counts right
+    for ( int round = 0; round < 20000; ++round ) {
+        int key = keys( gen );
+        switch ( round % 5 ) {
+        case 0:
+            ASSERT_EQ( expected.insert( key ).second, input.insert( key ).second );
+            break;
+        case 1:
+            ASSERT_EQ( expected.erase( key ), input.erase( key ) );
+            break;
+        case 2:
+            input.insert_buffered( key );
+            expected.insert( key );
+            break;
+        case 3:
+            ASSERT_EQ( expected.insert( key ).second,
+                       input.insert_from( input.find( key - 1 ), key ).second );
+            break;
+        default:
+            input.compact_step( 64 );
+        }
+        if ( round % 97 == 0 ) {
+            int lo     = keys( gen );
+            int hi     = lo + keys( gen ) / 20 + 1;
+            auto first = expected.lower_bound( lo );
+            auto last  = expected.lower_bound( hi );
+            auto count = std::distance( first, last );
+            ASSERT_EQ( count, input.extract_range( lo, hi ).size() );
+            expected.erase( first, last );
+            ASSERT_EQ( expected.size(), input.size() );
+        }
+    }
+    input.flush();
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ), contents( input ) );
+    ASSERT_EQ( expected.size(), input.erase_range( -1, 4001 ) );
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+struct counting_less {
+    explicit counting_less( std::size_t* count ) : count_( count ) {}
+
+    bool operator()( int a, int b ) const {
+        ++*count_;
+        return a < b;
+    }
+
+    std::size_t* count_;
+};
+
+// inserts 2 * i for i in [lo, hi) so that the tree comes out perfectly balanced
+template<class Tree_> void insert_balanced( Tree_& tree, int lo, int hi ) {
+    if ( lo >= hi ) return;
+    int mid = lo + ( hi - lo ) / 2;
+    tree.insert( 2 * mid );
+    insert_balanced( tree, lo, mid );
+    insert_balanced( tree, mid + 1, hi );
+}
+} // namespace
+
+TEST( BST, LOWER_BOUND_TEST ) {
+    tlib::bst<int> input;
+    for ( int i : {40, 20, 60, 10, 30} )
+        input.insert( i );
+    ASSERT_EQ( 30, *input.lower_bound( 25 ) );
+    ASSERT_EQ( 30, *input.lower_bound( 30 ) );
+    ASSERT_EQ( 10, *input.lower_bound( -1 ) );
+    ASSERT_TRUE( input.lower_bound( 61 ) == input.end() );
+}
+
+TEST( BST, FINGER_SEARCH_TEST ) {
+    tlib::bst<int> input;
+    ASSERT_TRUE( input.lower_bound_from( input.cend(), 5 ) == input.end() );
+    for ( int i : {40, 20, 60, 10, 30, 50, 70} )
+        input.insert( i );
+    auto finger = input.find( 10 );
+    ASSERT_EQ( 50, *input.lower_bound_from( finger, 45 ) );
+    ASSERT_EQ( 70, *input.find_from( finger, 70 ) );
+    ASSERT_TRUE( input.find_from( finger, 65 ) == input.end() );
+    ASSERT_EQ( 10, *input.lower_bound_from( input.cend(), 0 ) );
+    ASSERT_TRUE( input.lower_bound_from( input.find( 70 ), 71 ) == input.end() );
+}
+
+TEST( BST, FINGER_SEARCH_RANDOMIZED_TEST ) {
+    std::mt19937 gen( 13 );
+    std::uniform_int_distribution<int> keys( 0, 2000 );
+    tlib::bst<int> input;
+    std::set<int> expected;
+    for ( int i = 0; i < 500; ++i ) {
+        int key = keys( gen );
+        input.insert( key );
+        expected.insert( key );
+    }
+    std::vector<int> present( expected.begin(), expected.end() );
+    for ( int round = 0; round < 5000; ++round ) {
+        int key    = keys( gen ) - 10;
+        auto start = round % 50 == 0 ? input.end() : input.find( present[gen() % present.size()] );
+        auto it    = input.lower_bound_from( start, key );
+        auto want  = expected.lower_bound( key );
+        if ( want == expected.end() )
+            ASSERT_TRUE( it == input.end() );
+        else
+            ASSERT_EQ( *want, *it );
+    }
+}
+
+TEST( BST, INSERT_FROM_TEST ) {
+    std::mt19937 gen( 17 );
+    std::uniform_int_distribution<int> keys( 0, 3000 );
+    tlib::bst<int> input;
+    std::set<int> expected;
+    auto finger = input.end();
+    for ( int round = 0; round < 3000; ++round ) {
+        int key     = keys( gen );
+        auto result = input.insert_from( finger, key );
+        ASSERT_EQ( expected.insert( key ).second, result.second );
+        ASSERT_EQ( key, *result.first );
+        finger = result.first;
+    }
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ),
+               std::vector<int>( input.begin(), input.end() ) );
+    ASSERT_EQ( *expected.begin(), *input.begin() );
+    ASSERT_EQ( expected.size(), input.erase_range( -1, 3001 ) );
+}
+
+TEST( BST, FINGER_SEARCH_COMPARISONS_TEST ) {
+    const int levels        = 16;
+    const int count         = ( 1 << levels ) - 1;
+    std::size_t comparisons = 0;
+    tlib::bst<int, counting_less> input( ( counting_less( &comparisons ) ) );
+    insert_balanced( input, 0, count );
+
+    // the finger is the smallest key of the root's right subtree, the key just below it
+    int finger_key = 2 * ( count / 2 + 1 );
+    auto finger    = input.find( finger_key );
+    comparisons    = 0;
+    ASSERT_EQ( finger_key, *input.lower_bound_from( finger, finger_key - 1 ) );
+    ASSERT_LE( comparisons, 3 );
+    comparisons = 0;
+    ASSERT_EQ( finger_key, *input.lower_bound( finger_key - 1 ) );
+    ASSERT_GE( comparisons, levels );
+
+    // on average over the fingers, nearby keys cost fewer comparisons than a search from the
+    // root
+    std::mt19937 gen( 19 );
+    for ( int distance : {1, 8} ) {
+        std::size_t from_finger = 0;
+        std::size_t from_root   = 0;
+        for ( int round = 0; round < 1000; ++round ) {
+            int i  = distance + gen() % ( count - 2 * distance );
+            finger = input.find( 2 * i );
+            for ( int target : {i + distance, i - distance} ) {
+                comparisons = 0;
+                ASSERT_EQ( 2 * target, *input.lower_bound_from( finger, 2 * target - 1 ) );
+                from_finger += comparisons;
+                comparisons = 0;
+                input.lower_bound( 2 * target - 1 );
+                from_root += comparisons;
+            }
+        }
+        ASSERT_LT( 4 * from_finger, 3 * from_root );
+    }
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "lib/bst.h"
+
+namespace {
+struct reverse_less {
+    bool operator()( const std::string& a, const std::string& b ) const {
+        return b < a;
+    }
+};
+
+struct counting_less {
+    explicit counting_less( std::size_t* count ) : count_( count ) {}
+
+    bool operator()( int a, int b ) const {
+        ++*count_;
+        return a < b;
+    }
+
+    std::size_t* count_;
+};
+} // namespace
+
+TEST( BST_KEY_PREFIX, ENABLED_FOR_STRING_LESS_TEST ) {
+    ASSERT_TRUE( ( tlib::bst_cache_prefix<std::string, std::less<std::string>>::value ) );
+    ASSERT_TRUE( ( tlib::bst_cache_prefix<std::string, std::less<>>::value ) );
+    ASSERT_FALSE( ( tlib::bst_cache_prefix<std::string, reverse_less>::value ) );
+    ASSERT_FALSE( ( tlib::bst_cache_prefix<int, std::less<int>>::value ) );
+}
+
+TEST( BST_KEY_PREFIX, PREFIX_ORDER_TEST ) {
+    using prefix = tlib::bst_key_prefix<std::string>;
+    ASSERT_LT( prefix::make( "abc" ), prefix::make( "abd" ) );
+    ASSERT_LT( prefix::make( "ab" ), prefix::make( "ab\x01" ) );
+    ASSERT_LT( prefix::make( "a\x7f" ), prefix::make( "a\x80" ) );
+    ASSERT_EQ( prefix::make( "abcdefgh1" ), prefix::make( "abcdefgh2" ) );
+    ASSERT_EQ( prefix::make( "ab" ), prefix::make( std::string( "ab\0", 3 ) ) );
+}
+
+TEST( BST_KEY_PREFIX, STRING_TREE_MATCHES_SET_TEST ) {
+    std::mt19937 gen( 23 );
+    std::uniform_int_distribution<int> length( 0, 12 );
+    std::uniform_int_distribution<int> byte( 0, 255 );
+    tlib::bst<std::string> input;
+    tlib::bst<std::string, reverse_less> reversed;
+    std::set<std::string> expected;
+    for ( int round = 0; round < 4000; ++round ) {
+        // a common stem makes many prefixes tie, bytes above 0x7f test the unsigned order
+        std::string key = round % 2 ? "stem" : "";
+        for ( int n = length( gen ); n > 0; --n )
+            key.push_back( static_cast<char>( byte( gen ) % 4 == 0 ? 0 : byte( gen ) ) );
+        if ( round % 5 == 4 ) {
+            ASSERT_EQ( expected.erase( key ), input.erase( key ) );
+            reversed.erase( key );
+        } else {
+            ASSERT_EQ( expected.insert( key ).second, input.insert( key ).second );
+            reversed.insert( key );
+        }
+    }
+    ASSERT_EQ( std::vector<std::string>( expected.begin(), expected.end() ),
+               std::vector<std::string>( input.begin(), input.end() ) );
+    ASSERT_EQ( std::vector<std::string>( expected.rbegin(), expected.rend() ),
+               std::vector<std::string>( reversed.begin(), reversed.end() ) );
+    for ( const auto& key : expected ) {
+        ASSERT_EQ( key, *input.find( key ) );
+        ASSERT_EQ( key, *input.lower_bound_from( input.cbegin(), key ) );
+    }
+    ASSERT_TRUE( input.find( "stem\xff\xff\xff\xff\xff\xff\xff\xff\xff" ) == input.end() );
+}
+
+TEST( BST_KEY_PREFIX, ONE_COMPARISON_PER_NODE_TEST ) {
+    std::size_t comparisons = 0;
+    tlib::bst<int, counting_less> input( ( counting_less( &comparisons ) ) );
+    // ascending inserts make a chain leaning right, every lookup of the last key visits all
+    for ( int i = 0; i < 100; ++i )
+        input.insert( i );
+    comparisons = 0;
+    ASSERT_EQ( 99, *input.lower_bound( 99 ) );
+    ASSERT_EQ( 100, comparisons );
+    comparisons = 0;
+    ASSERT_EQ( 99, *input.find( 99 ) );
+    ASSERT_EQ( 101, comparisons );
+    auto finger = input.find( 0 );
+    comparisons = 0;
+    ASSERT_EQ( 99, *input.lower_bound_from( finger, 99 ) );
+    ASSERT_EQ( 100, comparisons );
+}
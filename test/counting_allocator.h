@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace tlib_test {
+
+/**
+ * @brief Process wide bookkeeping shared by every counting_allocator
+ *
+ */
+struct allocation_counter {
+    // bytes currently allocated
+    static std::size_t& live_bytes() {
+        static std::size_t bytes = 0;
+        return bytes;
+    }
+
+    // single object allocations allowed before one throws, negative for no limit
+    static long& single_allocations_left() {
+        static long left = -1;
+        return left;
+    }
+};
+
+/**
+ * @brief std::allocator which records the live bytes and can be made to fail
+ *
+ * @tparam T_ allocated type
+ */
+template<class T_> class counting_allocator {
+public:
+    using value_type = T_;
+
+    counting_allocator() noexcept = default;
+
+    template<class U_> counting_allocator( const counting_allocator<U_>& ) noexcept {}
+
+    T_* allocate( std::size_t n ) {
+        long& left = allocation_counter::single_allocations_left();
+        if ( n == 1 && left >= 0 ) {
+            if ( left == 0 ) throw std::bad_alloc();
+            --left;
+        }
+        T_* p = std::allocator<T_>().allocate( n );
+        allocation_counter::live_bytes() += n * sizeof( T_ );
+        return p;
+    }
+
+    void deallocate( T_* p, std::size_t n ) noexcept {
+        allocation_counter::live_bytes() -= n * sizeof( T_ );
+        std::allocator<T_>().deallocate( p, n );
+    }
+
+    template<class U_> bool operator==( const counting_allocator<U_>& ) const noexcept {
+        return true;
+    }
+
+    template<class U_> bool operator!=( const counting_allocator<U_>& ) const noexcept {
+        return false;
+    }
+};
+} // namespace tlib_test
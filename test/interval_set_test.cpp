@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lib/interval_set.h"
+
+namespace {
+using interval = std::pair<int, int>;
+
+std::vector<interval> brute_force( const std::set<interval>& intervals, int lo, int hi ) {
+    std::vector<interval> result;
+    for ( const auto& i : intervals )
+        if ( i.first <= hi && lo <= i.second ) result.push_back( i );
+    return result;
+}
+
+std::vector<interval> query( const tlib::interval_set<int>& intervals, int lo, int hi ) {
+    std::vector<interval> result;
+    for ( const auto& i : intervals.overlapping( lo, hi ) )
+        result.push_back( i );
+    return result;
+}
+} // namespace
+
+TEST( INTERVAL_SET, INSERT_ITERATE_TEST ) {
+    tlib::interval_set<int> input;
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.insert( 5, 10 ).second );
+    ASSERT_TRUE( input.insert( 1, 3 ).second );
+    ASSERT_TRUE( input.insert( 5, 7 ).second );
+    ASSERT_FALSE( input.insert( 1, 3 ).second );
+    ASSERT_EQ( 3, input.size() );
+    std::vector<interval> expected{{1, 3}, {5, 7}, {5, 10}};
+    ASSERT_EQ( expected, std::vector<interval>( input.begin(), input.end() ) );
+    ASSERT_THROW( input.insert( 4, 2 ), std::invalid_argument );
+}
+
+TEST( INTERVAL_SET, OVERLAP_TEST ) {
+    tlib::interval_set<int> input;
+    input.insert( 1, 3 );
+    input.insert( 5, 7 );
+    input.insert( 6, 20 );
+    input.insert( 12, 14 );
+    ASSERT_EQ( ( std::vector<interval>{{5, 7}, {6, 20}} ), query( input, 4, 6 ) );
+    ASSERT_EQ( ( std::vector<interval>{{6, 20}, {12, 14}} ), query( input, 13, 13 ) );
+    ASSERT_EQ( ( std::vector<interval>{{1, 3}} ), query( input, 0, 1 ) );
+    ASSERT_TRUE( input.overlapping( 21, 30 ).empty() );
+    ASSERT_TRUE( input.any_overlap( 3, 4 ) );
+    ASSERT_FALSE( input.any_overlap( 4, 4 ) );
+    ASSERT_FALSE( input.any_overlap( 8, 5 ) );
+}
+
+TEST( INTERVAL_SET, ERASE_TEST ) {
+    tlib::interval_set<int> input;
+    input.insert( 1, 3 );
+    input.insert( 5, 7 );
+    input.insert( 6, 20 );
+    ASSERT_EQ( 1, input.erase( interval( 6, 20 ) ) );
+    ASSERT_EQ( 0, input.erase( interval( 6, 20 ) ) );
+    ASSERT_FALSE( input.any_overlap( 10, 15 ) );
+    auto next = input.erase( input.cbegin() );
+    ASSERT_EQ( interval( 5, 7 ), *next );
+    ASSERT_EQ( 1, input.size() );
+    input.erase( input.cbegin() );
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.begin() == input.end() );
+}
+
+TEST( INTERVAL_SET, RANDOMIZED_AGAINST_SET_TEST ) {
+    std::mt19937 gen( 42 );
+    std::uniform_int_distribution<int> start( 0, 1000 );
+    std::uniform_int_distribution<int> length( 0, 50 );
+    tlib::interval_set<int> input;
+    std::set<interval> expected;
+    for ( int round = 0; round < 3000; ++round ) {
+        int lo = start( gen );
+        int hi = lo + length( gen );
+        if ( round % 3 == 2 && !expected.empty() ) {
+            auto it = expected.lower_bound( interval( lo, 0 ) );
+            if ( it == expected.end() ) it = expected.begin();
+            interval victim = *it;
+            ASSERT_EQ( 1, input.erase( victim ) );
+            expected.erase( victim );
+        } else {
+            ASSERT_EQ( expected.insert( interval( lo, hi ) ).second,
+                       input.insert( lo, hi ).second );
+        }
+        int qlo = start( gen );
+        int qhi = qlo + length( gen );
+        ASSERT_EQ( brute_force( expected, qlo, qhi ), query( input, qlo, qhi ) );
+        ASSERT_EQ( !brute_force( expected, qlo, qhi ).empty(), input.any_overlap( qlo, qhi ) );
+    }
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_TRUE( std::equal( expected.begin(), expected.end(), input.begin() ) );
+}
+
+TEST( INTERVAL_SET, STRING_ENDPOINT_TEST ) {
+    tlib::interval_set<std::string> input;
+    input.insert( "apple", "banana" );
+    input.insert( "cherry", "grape" );
+    ASSERT_TRUE( input.any_overlap( "date", "date" ) );
+    ASSERT_FALSE( input.any_overlap( "blueberry", "cabbage" ) );
+}
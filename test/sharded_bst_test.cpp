@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include "lib/sharded_bst.h"
+#include "test/counting_allocator.h"
+
+TEST( SHARDED_BST, INSERT_FIND_ERASE_TEST ) {
+    tlib::sharded_bst<int> input;
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.insert( 20 ) );
+    ASSERT_TRUE( input.insert( 10 ) );
+    ASSERT_FALSE( input.insert( 20 ) );
+    ASSERT_EQ( 2, input.size() );
+    ASSERT_TRUE( input.contains( 10 ) );
+    ASSERT_FALSE( input.contains( 15 ) );
+    ASSERT_EQ( 20, *input.find( 20 ) );
+    ASSERT_TRUE( input.find( 15 ) == input.end() );
+    ASSERT_EQ( 1, input.erase( 10 ) );
+    ASSERT_EQ( 0, input.erase( 10 ) );
+    ASSERT_EQ( 1, input.size() );
+}
+
+TEST( SHARDED_BST, SPLIT_KEEPS_ORDER_TEST ) {
+    tlib::sharded_bst<int> input;
+    std::set<int> expected;
+    std::mt19937 gen( 3 );
+    std::uniform_int_distribution<int> keys( 0, 1 << 20 );
+    for ( int i = 0; i < 20000; ++i ) {
+        int key = keys( gen );
+        ASSERT_EQ( expected.insert( key ).second, input.insert( key ) );
+    }
+    ASSERT_GT( input.shard_count(), 1 );
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_EQ( std::vector<int>( expected.begin(), expected.end() ),
+               std::vector<int>( input.begin(), input.end() ) );
+    for ( int key : expected )
+        ASSERT_TRUE( input.contains( key ) );
+}
+
+TEST( SHARDED_BST, SKEWED_INSERT_REBALANCES_TEST ) {
+    tlib::sharded_bst<int, std::less<int>, std::allocator<int>, 4> input;
+    for ( int i = 0; i < 8000; ++i )
+        input.insert( i );
+    ASSERT_EQ( 4, input.shard_count() );
+    for ( int i = 1000000; i < 1008000; ++i )
+        input.insert( i );
+    ASSERT_EQ( 16000, input.size() );
+    int previous = -1;
+    for ( int key : input ) {
+        ASSERT_LT( previous, key );
+        previous = key;
+    }
+    input.clear();
+    ASSERT_TRUE( input.empty() );
+    ASSERT_TRUE( input.begin() == input.end() );
+}
+
+TEST( SHARDED_BST, SPLIT_MOVES_NODES_TEST ) {
+    using set_type =
+        tlib::sharded_bst<int, std::less<int>, tlib_test::counting_allocator<int>, 4>;
+    long& allocations_left        = tlib_test::allocation_counter::single_allocations_left();
+    const std::size_t& live_bytes = tlib_test::allocation_counter::live_bytes();
+    std::size_t before            = live_bytes;
+    {
+        set_type input;
+        // one node per key and one header per shard, splits and merges allocate nothing
+        allocations_left = 16000 + 64;
+        bool exhausted   = false;
+        try {
+            for ( int i = 0; i < 8000; ++i )
+                input.insert( i );
+            for ( int i = 1000000; i < 1008000; ++i )
+                input.insert( i );
+        } catch ( const std::bad_alloc& ) {
+            exhausted = true;
+        }
+        allocations_left = -1;
+        ASSERT_FALSE( exhausted );
+        ASSERT_EQ( 4, input.shard_count() );
+        ASSERT_EQ( 16000, input.size() );
+        ASSERT_EQ( 16000, std::distance( input.begin(), input.end() ) );
+    }
+    ASSERT_EQ( before, live_bytes );
+}
+
+TEST( SHARDED_BST, CONCURRENT_WRITERS_TEST ) {
+    tlib::sharded_bst<int> input;
+    const int threads = 8;
+    const int per_thread = 5000;
+    std::vector<std::thread> writers;
+    for ( int t = 0; t < threads; ++t ) {
+        writers.emplace_back( [&input, t, per_thread] {
+            for ( int i = 0; i < per_thread; ++i )
+                input.insert( i * threads + t );
+            for ( int i = 0; i < per_thread; i += 2 )
+                input.erase( i * threads + t );
+        } );
+    }
+    for ( auto& writer : writers )
+        writer.join();
+    ASSERT_EQ( threads * per_thread / 2, input.size() );
+    std::vector<int> expected;
+    for ( int i = 0; i < threads * per_thread; ++i )
+        if ( ( i / threads ) % 2 ) expected.push_back( i );
+    ASSERT_EQ( expected, std::vector<int>( input.begin(), input.end() ) );
+}
+
+TEST( SHARDED_BST, CONCURRENT_LAYOUT_CHANGES_TEST ) {
+    tlib::sharded_bst<int, std::less<int>, std::allocator<int>, 4> input;
+    const int threads    = 4;
+    const int per_thread = 3000;
+    std::atomic<int> missing( 0 );
+    std::atomic<bool> done( false );
+    // every thread fills its own key range in order, which keeps splitting and merging shards
+    std::vector<std::thread> writers;
+    for ( int t = 0; t < threads; ++t ) {
+        writers.emplace_back( [&input, &missing, t, per_thread] {
+            for ( int i = 0; i < per_thread; ++i ) {
+                int key = t * per_thread + i;
+                input.insert( key );
+                if ( !input.contains( key ) ) ++missing;
+                if ( i % 3 == 0 && input.erase( key ) != 1 ) ++missing;
+            }
+        } );
+    }
+    std::thread observer( [&input, &done, &missing] {
+        while ( !done.load() )
+            if ( input.size() > threads * per_thread || input.shard_count() > 4 ) ++missing;
+    } );
+    for ( auto& writer : writers )
+        writer.join();
+    done = true;
+    observer.join();
+    ASSERT_EQ( 0, missing.load() );
+    ASSERT_GT( input.shard_count(), 1 );
+    std::vector<int> expected;
+    for ( int key = 0; key < threads * per_thread; ++key )
+        if ( ( key % per_thread ) % 3 ) expected.push_back( key );
+    ASSERT_EQ( expected.size(), input.size() );
+    ASSERT_EQ( expected, std::vector<int>( input.begin(), input.end() ) );
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <functional>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include "lib/bst.h"
+#include "lib/static_set.h"
+
+namespace {
+constexpr tlib::static_set<int, 8> primes{13, 2, 7, 3, 17, 5, 11, 19};
+constexpr tlib::static_set<int, 6> with_duplicates{4, 1, 4, 2, 1, 4};
+constexpr int reversed_keys[] = {1, 5, 3, 9};
+constexpr tlib::static_set<int, 4, std::greater<int>> reversed( reversed_keys );
+constexpr auto from_array = tlib::make_static_set( reversed_keys );
+constexpr tlib::static_set<int, 0> none{};
+
+constexpr bool is_sorted( const tlib::static_set<int, 8>& set ) {
+    for ( auto it = set.begin(); it + 1 < set.end(); ++it )
+        if ( !( *it < *( it + 1 ) ) ) return false;
+    return true;
+}
+
+// Everything below is evaluated by the compiler
+static_assert( primes.size() == 8, "all keys kept" );
+static_assert( is_sorted( primes ), "sorted at compile time" );
+static_assert( *primes.begin() == 2 && *( primes.end() - 1 ) == 19, "smallest and largest" );
+static_assert( primes.contains( 11 ) && !primes.contains( 12 ), "contains" );
+static_assert( primes.find( 7 ) == primes.begin() + 3, "find" );
+static_assert( primes.find( 4 ) == primes.end(), "find missing" );
+static_assert( *primes.lower_bound( 8 ) == 11, "lower_bound" );
+static_assert( primes.lower_bound( 20 ) == primes.end(), "lower_bound past the end" );
+static_assert( with_duplicates.size() == 3 && with_duplicates.max_size() == 6, "deduplicated" );
+static_assert( *reversed.begin() == 9 && *reversed.lower_bound( 4 ) == 3, "custom compare" );
+static_assert( from_array.size() == 4 && from_array.contains( 9 ), "make_static_set" );
+static_assert( none.empty() && !none.contains( 0 ), "empty set" );
+
+#if __cplusplus >= 201703L
+constexpr tlib::static_set<std::string_view, 4> keywords{"while", "for", "if", "else"};
+static_assert( *keywords.begin() == "else" && keywords.contains( "if" ), "string_view keys" );
+static_assert( !keywords.contains( "do" ), "string_view missing key" );
+#endif
+} // namespace
+
+TEST( STATIC_SET, ITERATION_TEST ) {
+    std::vector<int> expected{2, 3, 5, 7, 11, 13, 17, 19};
+    std::vector<int> actual( primes.begin(), primes.end() );
+    ASSERT_EQ( expected, actual );
+}
+
+TEST( STATIC_SET, MATCHES_BST_TEST ) {
+    tlib::bst<int> tree;
+    for ( int key : primes )
+        tree.insert( key );
+    for ( int key = 0; key < 25; ++key ) {
+        ASSERT_EQ( tree.contains( key ), primes.contains( key ) );
+        auto it = primes.lower_bound( key );
+        if ( it == primes.end() )
+            ASSERT_EQ( tree.lower_bound( key ), tree.end() );
+        else
+            ASSERT_EQ( *tree.lower_bound( key ), *it );
+    }
+}
+
+TEST( STATIC_SET, RUNTIME_CONSTRUCTION_TEST ) {
+    std::vector<int> input{6, 2, 9, 2};
+    tlib::static_set<int, 4> set{input[0], input[1], input[2], input[3]};
+    ASSERT_EQ( 3u, set.size() );
+    ASSERT_TRUE( set.contains( 9 ) );
+    ASSERT_THROW( ( tlib::static_set<int, 2>{1, 2, 3} ), std::length_error );
+}